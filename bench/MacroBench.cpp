@@ -0,0 +1,399 @@
+#include "Macro.h"
+
+#include <sc2utils/sc2_arg_parser.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Data.h"
+#include "Utilities.h"
+
+using namespace scdata;
+using namespace scbot;
+
+namespace
+{
+
+struct Options
+{
+    Options(): Time(5.0f), Depth(0), Threads(1), TableSize(MACRO_TRANSPOSITION_SIZE_MB), Simple(false),
+        FailOverBudget(false), UnitTypes(MACRO_BENCH_DATA_DIR "/unit_types.txt")
+    {}
+
+    float Time;
+    int32_t Depth;
+    uint32_t Threads;
+    size_t TableSize;
+    bool Simple;
+    bool FailOverBudget;
+    SearchOptions Search;
+    std::string UnitTypes;
+    std::string Fixture;
+    std::string Book;
+    std::string WriteBook;
+};
+
+void ParseArguments(int argc, char* argv[], Options* options_)
+{
+    sc2::ArgParser arg_parser(argv[0]);
+    arg_parser.AddOptions(
+        {
+            {"-t", "--Time", "Seconds to search each fixture, ignored with a depth", false},
+            {"-d", "--Depth", "Depth to search each fixture to", false},
+            {"-j", "--Threads", "Number of search threads, 0 for all but one hardware thread", false},
+            {"-m", "--TableSize", "Transposition table size in megabytes", false},
+            {"-s", "--Simple", "Complete units instantly instead of modelling production time (0 or 1)", false},
+            {"-p", "--PrincipalVariation", "Use principal variation search (0 or 1)", false},
+            {"-a", "--Aspiration", "Half width of the aspiration window, 0 for a full window", false},
+            {"-l", "--LateMoveReductions", "Search moves ordered late with less depth (0 or 1)", false},
+            {"-n", "--NullMove", "Prune nodes where passing is good enough (0 or 1)", false},
+            {"-b", "--Backend", "Search algorithm, alphabeta, montecarlo or beam", false},
+            {"-w", "--BeamWidth", "States the beam search keeps per time slice", false},
+            {"-x", "--MaxWait", "Longest wait of a move that waits until it is affordable, 0 to disable them", false},
+            {"-i", "--Playouts", "Playouts after which a Monte Carlo search finishes, 0 for no limit", false},
+            {"-u", "--UnitTypes", "Unit type table written by Utilities::WriteUnitTypes", false},
+            {"-f", "--Fixture", "Only run the fixture with this name", false},
+            {"-k", "--Book", "Opening book to follow where it covers the fixture", false},
+            {"-o", "--WriteBook", "Write an opening book from the lines found for the fixtures", false},
+            {"-g", "--FailOverBudget", "Exit with a non-zero status when completing a search goes over MACRO_COMPLETE_BUDGET_MS (0 or 1)", false},
+        });
+
+    arg_parser.Parse(argc, argv);
+
+    std::string value;
+    if (arg_parser.Get("Time", value))
+        options_->Time = static_cast<float>(atof(value.c_str()));
+
+    if (arg_parser.Get("Depth", value))
+        options_->Depth = atoi(value.c_str());
+
+    if (arg_parser.Get("Threads", value))
+        options_->Threads = static_cast<uint32_t>(atoi(value.c_str()));
+
+    if (arg_parser.Get("TableSize", value))
+        options_->TableSize = static_cast<size_t>(atoi(value.c_str()));
+
+    if (arg_parser.Get("Simple", value))
+        options_->Simple = atoi(value.c_str()) != 0;
+
+    if (arg_parser.Get("PrincipalVariation", value))
+        options_->Search.principal_variation = atoi(value.c_str()) != 0;
+
+    if (arg_parser.Get("Aspiration", value))
+        options_->Search.aspiration_window = atof(value.c_str());
+
+    if (arg_parser.Get("LateMoveReductions", value))
+        options_->Search.late_move_reductions = atoi(value.c_str()) != 0;
+
+    if (arg_parser.Get("NullMove", value))
+        options_->Search.null_move_pruning = atoi(value.c_str()) != 0;
+
+    if (arg_parser.Get("Backend", value))
+        options_->Search.backend = value == "montecarlo" ? SearchBackend::MonteCarlo : value == "beam" ? SearchBackend::Beam : SearchBackend::AlphaBeta;
+
+    if (arg_parser.Get("BeamWidth", value))
+        options_->Search.beam_width = static_cast<size_t>(atoi(value.c_str()));
+
+    if (arg_parser.Get("MaxWait", value))
+        options_->Search.max_wait = static_cast<float>(atof(value.c_str()));
+
+    if (arg_parser.Get("Playouts", value))
+        options_->Search.max_playouts = static_cast<uint64_t>(atoll(value.c_str()));
+
+    if (arg_parser.Get("FailOverBudget", value))
+        options_->FailOverBudget = atoi(value.c_str()) != 0;
+
+    arg_parser.Get("UnitTypes", options_->UnitTypes);
+    arg_parser.Get("Fixture", options_->Fixture);
+    arg_parser.Get("Book", options_->Book);
+    arg_parser.Get("WriteBook", options_->WriteBook);
+}
+
+struct Fixture
+{
+    std::string Name;
+    std::function<void(BoardState&)> Setup;
+};
+
+void Add(PlayerState& player, sc2::UNIT_TYPEID type, uint16_t count)
+{
+    player.units[GetMacroUnitIndex(type)] += count;
+}
+
+// Unit that completes after the given number of seconds, only used by the timeline model
+void AddPending(PlayerState& player, sc2::UNIT_TYPEID type, float complete_time)
+{
+    const auto index = GetMacroUnitIndex(type);
+
+    player.pending[player.pending_count++] = {complete_time, index};
+    player.planned_units[index] += 1;
+}
+
+void SetupOpening(BoardState& state)
+{
+    for (auto* player : {&state.friendly_units, &state.enemy_units}) {
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_NEXUS, 1);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_PROBE, 12);
+        player->resources = {50, 0};
+    }
+}
+
+void SetupMidgame(BoardState& state)
+{
+    auto& friendly = state.friendly_units;
+    Add(friendly, sc2::UNIT_TYPEID::PROTOSS_NEXUS, 2);
+    Add(friendly, sc2::UNIT_TYPEID::PROTOSS_PROBE, 38);
+    Add(friendly, sc2::UNIT_TYPEID::PROTOSS_ASSIMILATOR, 3);
+    Add(friendly, sc2::UNIT_TYPEID::PROTOSS_PYLON, 5);
+    Add(friendly, sc2::UNIT_TYPEID::PROTOSS_GATEWAY, 3);
+    Add(friendly, sc2::UNIT_TYPEID::PROTOSS_CYBERNETICSCORE, 1);
+    Add(friendly, sc2::UNIT_TYPEID::PROTOSS_ROBOTICSFACILITY, 1);
+    Add(friendly, sc2::UNIT_TYPEID::PROTOSS_STALKER, 6);
+    Add(friendly, sc2::UNIT_TYPEID::PROTOSS_ADEPT, 2);
+    Add(friendly, sc2::UNIT_TYPEID::PROTOSS_OBSERVER, 1);
+    AddPending(friendly, sc2::UNIT_TYPEID::PROTOSS_TWILIGHTCOUNCIL, 20.0f);
+    AddPending(friendly, sc2::UNIT_TYPEID::PROTOSS_IMMORTAL, 12.0f);
+    friendly.resources = {400, 150};
+
+    auto& enemy = state.enemy_units;
+    Add(enemy, sc2::UNIT_TYPEID::PROTOSS_NEXUS, 2);
+    Add(enemy, sc2::UNIT_TYPEID::PROTOSS_PROBE, 36);
+    Add(enemy, sc2::UNIT_TYPEID::PROTOSS_ASSIMILATOR, 4);
+    Add(enemy, sc2::UNIT_TYPEID::PROTOSS_PYLON, 5);
+    Add(enemy, sc2::UNIT_TYPEID::PROTOSS_GATEWAY, 2);
+    Add(enemy, sc2::UNIT_TYPEID::PROTOSS_CYBERNETICSCORE, 1);
+    Add(enemy, sc2::UNIT_TYPEID::PROTOSS_STARGATE, 1);
+    Add(enemy, sc2::UNIT_TYPEID::PROTOSS_STALKER, 4);
+    Add(enemy, sc2::UNIT_TYPEID::PROTOSS_ORACLE, 1);
+    enemy.resources = {300, 200};
+}
+
+void SetupLategame(BoardState& state)
+{
+    for (auto* player : {&state.friendly_units, &state.enemy_units}) {
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_NEXUS, 4);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_PROBE, 66);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_ASSIMILATOR, 8);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_PYLON, 14);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_GATEWAY, 8);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_FORGE, 2);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_CYBERNETICSCORE, 1);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_TWILIGHTCOUNCIL, 1);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_TEMPLARARCHIVE, 1);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_ROBOTICSFACILITY, 2);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_ROBOTICSBAY, 1);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_STARGATE, 1);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_FLEETBEACON, 1);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_PHOTONCANNON, 4);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_SHIELDBATTERY, 4);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_ZEALOT, 10);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_STALKER, 8);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_HIGHTEMPLAR, 4);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_IMMORTAL, 3);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_COLOSSUS, 2);
+        Add(*player, sc2::UNIT_TYPEID::PROTOSS_OBSERVER, 2);
+        player->resources = {1200, 800};
+    }
+
+    AddPending(state.friendly_units, sc2::UNIT_TYPEID::PROTOSS_CARRIER, 30.0f);
+    AddPending(state.friendly_units, sc2::UNIT_TYPEID::PROTOSS_NEXUS, 45.0f);
+}
+
+// Peak resident memory of the process in bytes
+size_t GetPeakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+const char* BackendName(SearchBackend backend)
+{
+    switch (backend) {
+    case SearchBackend::MonteCarlo:
+        return "montecarlo";
+    case SearchBackend::Beam:
+        return "beam";
+    default:
+        return "alphabeta";
+    }
+}
+
+std::string FormatLine(const std::vector<Move>& moves)
+{
+    std::string line;
+    for (const auto& move : moves) {
+        if (!line.empty()) {
+            line += " ";
+        }
+
+        const auto& it = UnitTypeNames.find(move.unit);
+        line += move.nullmove ? "Pass" : it != UnitTypeNames.end() ? it->second : std::to_string(static_cast<int32_t>(move.unit));
+
+        if (move.wait_time > 0.0f) {
+            line += "@+" + std::to_string(static_cast<int32_t>(std::ceil(move.wait_time))) + "s";
+        }
+    }
+    return line;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    ParseArguments(argc, argv, &options);
+
+    sc2::UnitTypes unit_types;
+    if (!Utilities::ReadUnitTypes(options.UnitTypes, unit_types)) {
+        std::cerr << "Could not read unit types from " << options.UnitTypes << std::endl;
+        return 1;
+    }
+
+    const std::vector<Fixture> fixtures = {
+        {"opening", SetupOpening},
+        {"midgame", SetupMidgame},
+        {"lategame", SetupLategame},
+    };
+
+    std::cout << std::fixed << std::setprecision(2);
+
+    std::shared_ptr<OpeningBook> book;
+    if (!options.Book.empty()) {
+        book = std::make_shared<OpeningBook>();
+
+        if (!book->Open(options.Book)) {
+            std::cerr << "Could not open opening book " << options.Book << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<OpeningBookEntry> book_entries;
+
+    // Fixtures where completing the search stalled longer than the game step can afford, wall-clock so only a hint
+    // unless --FailOverBudget asks for a gate
+    std::vector<std::string> over_budget;
+
+    for (const auto& fixture : fixtures) {
+        if (!options.Fixture.empty() && options.Fixture != fixture.Name) {
+            continue;
+        }
+
+        BoardState state {};
+        fixture.Setup(state);
+        state.turn = true;
+        state.simple = options.Simple;
+
+        // Every fixture starts from an empty table so runs can be compared
+        Macro macro(unit_types);
+        macro.SetSearchThreads(options.Threads);
+        macro.SetTranspositionTableSize(options.TableSize);
+        macro.SetSearchOptions(options.Search);
+        macro.SetOpeningBook(book);
+        if (options.Depth > 0) {
+            macro.SetMaxDepth(options.Depth);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        auto promise = macro.Search(state);
+
+        // The beam search finishes on its own once it has planned up to the horizon
+        if (options.Depth > 0 || options.Search.max_playouts > 0 || options.Search.backend == SearchBackend::Beam) {
+            promise->Wait();
+        } else {
+            std::this_thread::sleep_for(std::chrono::duration<float>(options.Time));
+        }
+
+        // The line the bot would act on if it looked while the search is still running
+        const auto peeked = promise->Peek();
+
+        // How long the game step that takes the result would stall, bounded by the cancellation interval
+        const auto complete = std::chrono::steady_clock::now();
+        const auto result = promise->Complete();
+        const auto latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - complete).count();
+
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const auto statistics = promise->GetStatistics();
+        const auto hit_rate = statistics.tt_probes != 0 ? 100.0 * statistics.tt_hits / statistics.tt_probes : 0.0;
+
+        std::cout << "Fixture: " << fixture.Name << std::endl;
+        std::cout << "  Time: " << seconds << " s" << std::endl;
+        std::cout << "  Complete: " << latency << " ms (budget " << MACRO_COMPLETE_BUDGET_MS << " ms)" << std::endl;
+        std::cout << "  Peek: depth " << (peeked != nullptr ? peeked->depth : 0) << " before completing" << std::endl;
+        std::cout << "  Depth: " << statistics.depth << std::endl;
+        std::cout << "  Nodes: " << statistics.nodes << std::endl;
+        std::cout << "  Nodes/s: " << statistics.nodes / seconds << std::endl;
+        std::cout << "  TT hit rate: " << hit_rate << " % (" << statistics.tt_cutoffs << " cutoffs)" << std::endl;
+        std::cout << "  PVS: " << (options.Search.principal_variation ? "on" : "off") << ", " << statistics.pvs_researches << " of " << statistics.pvs_searches << " null window searches repeated" << std::endl;
+        std::cout << "  Aspiration window: " << options.Search.aspiration_window << ", " << statistics.aspiration_researches << " iterations repeated" << std::endl;
+        std::cout << "  LMR: " << (options.Search.late_move_reductions ? "on" : "off") << ", " << statistics.reduction_researches << " of " << statistics.reductions << " reduced moves repeated, " << statistics.reduction_nodes << " nodes in kept reductions" << std::endl;
+        std::cout << "  Null move: " << (options.Search.null_move_pruning ? "on" : "off") << ", " << statistics.null_move_cutoffs << " of " << statistics.null_moves << " cut off, " << statistics.null_move_nodes << " nodes in null searches" << std::endl;
+        if (options.Search.backend == SearchBackend::MonteCarlo) {
+            std::cout << "  Playouts: " << statistics.playouts << " (" << statistics.playouts / seconds << " /s), " << statistics.tree_nodes << " tree nodes" << std::endl;
+        }
+        if (options.Search.backend == SearchBackend::Beam) {
+            std::cout << "  Beam: width " << options.Search.beam_width << ", " << statistics.beam_duplicates << " duplicate states dropped" << std::endl;
+        }
+        if (statistics.book_moves != 0) {
+            std::cout << "  Book: " << statistics.book_moves << " moves" << std::endl;
+        }
+        std::cout << "  Score: " << result->score << std::endl;
+        std::cout << "  Line: " << FormatLine(result->moves) << std::endl;
+
+        if (latency > MACRO_COMPLETE_BUDGET_MS) {
+            over_budget.push_back(fixture.Name);
+        }
+
+        if (!options.WriteBook.empty()) {
+            const auto entries = macro.GetOpeningBookEntries(state, *result);
+            book_entries.insert(book_entries.end(), entries.begin(), entries.end());
+        }
+    }
+
+    if (!options.WriteBook.empty()) {
+        if (!OpeningBook::Write(options.WriteBook, book_entries)) {
+            std::cerr << "Could not write opening book " << options.WriteBook << std::endl;
+            return 1;
+        }
+
+        std::cout << "Opening book: " << book_entries.size() << " positions written to " << options.WriteBook << std::endl;
+    }
+
+    std::cout << "Peak memory: " << GetPeakMemory() / (1024.0 * 1024.0) << " MB" << std::endl;
+
+    for (const auto& name : over_budget) {
+        std::cerr << "Completing " << name << " with the " << BackendName(options.Search.backend) <<
+            " backend took longer than " << MACRO_COMPLETE_BUDGET_MS << " ms" << std::endl;
+    }
+
+    return options.FailOverBudget && !over_budget.empty() ? 1 : 0;
+}
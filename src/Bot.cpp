@@ -24,6 +24,7 @@
 #include <unordered_set>
 #include <limits>
 
+#include "Config.h"
 #include "Utilities.h"
 #include "Map.h"
 #include "Production.h"
@@ -51,6 +52,20 @@ void Bot::OnGameStart()
     m_Liberation = std::make_shared<Liberation>(m_Collective);
     m_Macro = std::make_shared<Macro>(m_Collective);
 
+#ifdef MACRO_OPENING_BOOK
+    // The first plans of the game become lookups, the search time goes to the positions the book does not cover
+    auto book = std::make_shared<OpeningBook>();
+    if (book->Open(MACRO_OPENING_BOOK)) {
+        std::cout << "Opening book with " << book->GetSize() << " positions" << std::endl;
+        m_Macro->SetOpeningBook(book);
+    }
+#endif
+
+#ifdef MACRO_UNIT_TYPES_DUMP
+    // Unit type table for the offline macro benchmark
+    Utilities::WriteUnitTypes(MACRO_UNIT_TYPES_DUMP, Observation()->GetUnitTypeData());
+#endif
+
     m_NextBuildDispatch = 0;
 }
 
@@ -66,6 +81,8 @@ void Bot::OnBuildingConstructionComplete(const sc2::Unit* building_)
 {
     std::cout << sc2::UnitTypeToName(building_->unit_type) <<
         "(" << building_->tag << ") constructed" << std::endl;
+
+    m_Collective->OnBuildingConstructionComplete(building_);
 }
 
 void Bot::OnStep()
@@ -107,29 +124,12 @@ void Bot::OnStep()
 
     if (m_NextMacroDispatch < time_in_seconds) {
         if (m_HasMacroPromise) {
+            // Search() waits for the workers to park before it hands over the next root, completing first costs nothing more
             auto result = m_MacroPromise->Complete();
 
-            const auto& moves = result->moves;
-
-            m_BuildOrder.clear();
-            m_BuildOrder.reserve(moves.size());
-            for (const auto& move : moves) {
-                if (move.nullmove) {
-                    continue;
-                }
-
-                const auto& ability_it = UnitToAbility.find(move.unit);
-
-                if (ability_it == UnitToAbility.end()) {
-                    continue;
-                }
-
-                const auto& ability = ability_it->second;
+            SetBuildOrder(*result);
 
-                m_BuildOrder.push_back({ability, 0});
-            }
-            
-            for (const auto& move : moves) {
+            for (const auto& move : result->moves) {
                 const auto& name_it = UnitTypeNames.find(move.unit);
 
                 if (name_it != UnitTypeNames.end()) {
@@ -141,10 +141,20 @@ void Bot::OnStep()
         }
 
         m_MacroPromise = m_Macro->Search();
+        m_MacroSnapshot = nullptr;
+        m_MacroLine.clear();
 
         m_HasMacroPromise = true;
 
         m_NextMacroDispatch = time_in_seconds + 10.0f;
+    } else if (m_HasMacroPromise && m_BuildOrder.empty()) {
+        // Nothing left to build, take the deepest line of the running search instead of idling until it is completed
+        auto snapshot = m_MacroPromise->Peek();
+
+        if (snapshot != nullptr && snapshot != m_MacroSnapshot) {
+            SetBuildOrder(*snapshot);
+            m_MacroSnapshot = std::move(snapshot);
+        }
     }
 
     // Check if the next build dispatch time has been reached.
@@ -387,6 +397,8 @@ void Bot::OnUnitCreated(const sc2::Unit* unit_)
 {
     std::cout << sc2::UnitTypeToName(unit_->unit_type) <<
         "(" << unit_->tag << ") was created" << std::endl;
+
+    m_Collective->OnUnitCreated(unit_);
 }
 
 void Bot::OnUnitIdle(const sc2::Unit* unit)
@@ -421,6 +433,8 @@ void Bot::OnUnitDestroyed(const sc2::Unit* unit)
     std::cout << sc2::UnitTypeToName(unit->unit_type) <<
          "(" << unit->tag << ") was destroyed" << std::endl;
 
+    m_Collective->OnUnitDestroyed(unit);
+
     // Remove from delayed orders.
     const auto& it = m_DelayedOrders.find(unit->tag);
 
@@ -480,6 +494,8 @@ void Bot::OnUnitEnterVision(const sc2::Unit* unit_)
 {
     std::cout << sc2::UnitTypeToName(unit_->unit_type) <<
         "(" << unit_->tag << ") entered vision" << std::endl;
+
+    m_Collective->OnUnitEnterVision(unit_);
 }
 
 void Bot::OnError(const std::vector<sc2::ClientError>& client_errors,
@@ -494,6 +510,52 @@ void Bot::OnError(const std::vector<sc2::ClientError>& client_errors,
         std::cerr << "Encountered protocol error: " << i << std::endl;
 }
 
+void Bot::SetBuildOrder(const MoveSequence& sequence)
+{
+    const auto& moves = sequence.moves;
+
+    std::vector<sc2::ABILITY_ID> line;
+    line.reserve(moves.size());
+    for (const auto& move : moves) {
+        if (move.nullmove) {
+            continue;
+        }
+
+        const auto& ability_it = UnitToAbility.find(move.unit);
+
+        if (ability_it == UnitToAbility.end()) {
+            continue;
+        }
+
+        line.push_back(ability_it->second);
+    }
+
+    if (m_MacroLine.empty()) {
+        // Nothing of this root has been queued yet, the line replaces the build order
+        m_BuildOrder.clear();
+        m_BuildOrder.reserve(line.size());
+        for (const auto& ability : line) {
+            m_BuildOrder.push_back({ability, 0});
+        }
+
+        m_MacroLine = std::move(line);
+
+        return;
+    }
+
+    // Every line of the search starts from the same root, the moves already queued from it must not be queued again
+    if (line.size() < m_MacroLine.size() || !std::equal(m_MacroLine.begin(), m_MacroLine.end(), line.begin())) {
+        // The line starts differently from what is already being built, it does not continue it
+        return;
+    }
+
+    for (auto it = line.begin() + m_MacroLine.size(); it != line.end(); ++it) {
+        m_BuildOrder.push_back({*it, 0});
+    }
+
+    m_MacroLine = std::move(line);
+}
+
 ResourcePair Bot::GetPlannedCosts()
 {
     ResourcePair planned_cost = {0, 0};
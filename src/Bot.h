@@ -115,6 +115,15 @@ private:
     std::shared_ptr<scbot::MacroPromise> m_MacroPromise;
     bool m_HasMacroPromise = false;
 
+    // Last line of the running search that the build order was taken from
+    std::shared_ptr<const scbot::MoveSequence> m_MacroSnapshot;
+
+    // Moves of the running search's root that have been queued in the build order, in line order
+    std::vector<sc2::ABILITY_ID> m_MacroLine;
+
+    // Queues the moves of a search line that are not queued yet, a line that does not continue the queued moves is discarded
+    void SetBuildOrder(const scbot::MoveSequence& sequence);
+
     ResourcePair GetPlannedCosts();
 
     float ElapsedTime();
@@ -5,7 +5,10 @@
 #include <sc2api/sc2_interfaces.h>
 #include <sc2lib/sc2_search.h>
 
+#include <iostream>
+
 #include "Map.h"
+#include "MapCache.h"
 
 sc2::Units scbot::Collective::s_EmptyUnits {};
 
@@ -14,9 +17,14 @@ scbot::Collective::Collective(sc2::Agent* bot)
     NON_NULL(bot);
 
     this->bot = bot;
+
+    m_ThreadPool = std::make_unique<ThreadPool>(BOT_WORKER_THREADS);
+    m_Scheduler = std::make_unique<Scheduler>();
+    m_PlacementGrid = std::make_unique<PlacementGrid>(Observation());
+    m_PathingGrid = std::make_unique<PathingGrid>(Observation());
+    m_QueryBroker = std::make_unique<QueryBroker>(Query());
     
-    m_Ramps = Map::FindRamps(Query(), Observation());
-    m_Expansions = sc2::search::CalculateExpansionLocations(Observation(), Query());
+    LoadMapAnalysis();
 }
 
 scbot::Collective::~Collective()
@@ -83,6 +91,45 @@ const sc2::Units& scbot::Collective::GetAllUnits() const
 void scbot::Collective::OnStep()
 {
     UpdateUnits();
+
+    const auto game_loop = Observation()->GetGameLoop();
+
+    m_PlacementGrid->ExpireRejections(game_loop);
+
+    if (game_loop >= m_NextPlacementRefresh) {
+        m_PlacementGrid->RemoveMissingUnits();
+        m_NextPlacementRefresh = game_loop + PLACEMENT_REFRESH_LOOPS;
+    }
+
+    // Answers the queries of the last step before anything registers new ones
+    m_QueryBroker->Flush();
+
+    // Routines continue with the units of this step
+    m_Scheduler->OnStep();
+}
+
+void scbot::Collective::OnUnitCreated(const sc2::Unit* unit)
+{
+    m_PlacementGrid->AddUnit(unit);
+    m_PathingGrid->AddUnit(unit);
+}
+
+void scbot::Collective::OnBuildingConstructionComplete(const sc2::Unit* unit)
+{
+    // Already added when construction started, unless the start was missed
+    m_PlacementGrid->AddUnit(unit);
+    m_PathingGrid->AddUnit(unit);
+}
+
+void scbot::Collective::OnUnitDestroyed(const sc2::Unit* unit)
+{
+    m_PlacementGrid->RemoveUnit(unit);
+    m_PathingGrid->RemoveUnit(unit);
+}
+
+void scbot::Collective::OnUnitEnterVision(const sc2::Unit* unit)
+{
+    m_PlacementGrid->AddUnit(unit);
 }
 
 sc2::ActionInterface* scbot::Collective::Actions()
@@ -143,6 +190,97 @@ sc2::Point2D scbot::Collective::GetClosestRamp(const sc2::Point2D& position) con
     return closest_ramp;
 }
 
+const scbot::PlacementGrid& scbot::Collective::GetPlacementGrid() const
+{
+    return *m_PlacementGrid;
+}
+
+const scbot::PathingGrid& scbot::Collective::GetPathingGrid() const
+{
+    return *m_PathingGrid;
+}
+
+std::optional<bool> scbot::Collective::ConfirmPlacement(sc2::ABILITY_ID ability_id, const sc2::Point2D& point)
+{
+    const auto game_loop = Observation()->GetGameLoop();
+
+    auto& confirmation = m_PlacementConfirmations[ability_id];
+
+    // A different spot starts over, the answer for the old one says nothing about it
+    if (!confirmation.querying && confirmation.has_answer && confirmation.point != point) {
+        confirmation.has_answer = false;
+    }
+
+    const bool stale = !confirmation.has_answer || game_loop >= confirmation.answered + PLACEMENT_CONFIRMATION_LOOPS;
+
+    if (!confirmation.querying && stale) {
+        confirmation.point = point;
+        confirmation.querying = true;
+
+        m_QueryBroker->Placement(sc2::QueryInterface::PlacementQuery(ability_id, point), [this, ability_id, point](bool placeable) {
+            const auto answered = Observation()->GetGameLoop();
+
+            if (placeable) {
+                m_PlacementGrid->Confirm(ability_id, point);
+            } else {
+                m_PlacementGrid->Reject(ability_id, point, answered + PLACEMENT_REJECTION_LOOPS);
+            }
+
+            auto& confirmation = m_PlacementConfirmations[ability_id];
+            confirmation.answered = answered;
+            confirmation.has_answer = true;
+            confirmation.placeable = placeable;
+            confirmation.querying = false;
+        });
+    }
+
+    if (!confirmation.has_answer || confirmation.point != point) {
+        return std::nullopt;
+    }
+
+    return confirmation.placeable;
+}
+
+void scbot::Collective::LoadMapAnalysis()
+{
+#ifdef MAP_CACHE_DIRECTORY
+    const auto hash = MapCache::Hash(Observation()->GetGameInfo());
+    const auto path = MapCache::GetPath(MAP_CACHE_DIRECTORY, hash);
+
+    MapCache cache;
+
+    if (cache.Open(path, hash)) {
+        const auto ramps = cache.GetRamps();
+        const auto expansions = cache.GetExpansions();
+
+        m_Ramps.assign(ramps.begin(), ramps.end());
+        m_Expansions.assign(expansions.begin(), expansions.end());
+
+        return;
+    }
+#endif
+
+    m_Ramps = Map::FindRamps(Query(), Observation());
+    m_Expansions = sc2::search::CalculateExpansionLocations(Observation(), Query());
+
+#ifdef MAP_CACHE_DIRECTORY
+    // The next game on this map skips the analysis and its queries
+    m_Scheduler->Spawn(WriteMapCache(path, hash));
+#endif
+}
+
+Routine scbot::Collective::WriteMapCache(std::string path, uint64_t hash)
+{
+    // The analysis needs the client and stays on the game thread, the disk does not and the first step should not wait on it
+    const bool written = co_await m_ThreadPool->Submit([path, hash, ramps = m_Ramps, expansions = m_Expansions]() {
+        return MapCache::Write(path, hash, ramps, expansions);
+    });
+
+    if (!written) {
+        std::cerr << "Could not write the map cache " << path << std::endl;
+    }
+}
+
 void scbot::Collective::UpdateUnits()
 {
     const sc2::ObservationInterface* observation = bot->Observation();
@@ -174,5 +312,3 @@ void scbot::Collective::UpdateUnits()
         }
     }
 }
-
-
@@ -3,10 +3,18 @@
 #include <sc2api/sc2_agent.h>
 #include <sc2api/sc2_unit.h>
 
+#include <memory>
+#include <optional>
+#include <string>
 #include <unordered_map>
 
 #include "config.h"
 #include "Data.h"
+#include "PathingGrid.h"
+#include "PlacementGrid.h"
+#include "QueryBroker.h"
+#include "Scheduler.h"
+#include "ThreadPool.h"
 
 namespace scbot
 {
@@ -100,6 +108,34 @@ public:
      */
     void OnStep();
 
+    /**
+     * @brief Method to call when a unit is created.
+     * 
+     * @param unit The unit
+     */
+    void OnUnitCreated(const sc2::Unit* unit);
+
+    /**
+     * @brief Method to call when a building has finished construction.
+     * 
+     * @param unit The building
+     */
+    void OnBuildingConstructionComplete(const sc2::Unit* unit);
+
+    /**
+     * @brief Method to call when a unit is destroyed.
+     * 
+     * @param unit The unit
+     */
+    void OnUnitDestroyed(const sc2::Unit* unit);
+
+    /**
+     * @brief Method to call when an enemy unit enters vision.
+     * 
+     * @param unit The unit
+     */
+    void OnUnitEnterVision(const sc2::Unit* unit);
+
     /**
      * @brief Get the Actions object for the bot.
      * 
@@ -164,6 +200,33 @@ public:
      */
     sc2::Point2D GetClosestRamp(const sc2::Point2D& position) const;
 
+    /**
+     * @brief Get the local placement grid, kept up to date with the structures on the map.
+     * 
+     * @return The placement grid
+     */
+    const PlacementGrid& GetPlacementGrid() const;
+
+    /**
+     * @brief Get the local pathing grid, kept up to date with our structures on the map.
+     * 
+     * @return The pathing grid
+     */
+    const PathingGrid& GetPathingGrid() const;
+
+    /**
+     * @brief Check a spot chosen from the placement grid with the game, through the queries of the step.
+     * 
+     * The first call for a spot only registers the query, the answer is there from the next step on. An answer is
+     * refreshed once it is PLACEMENT_CONFIRMATION_LOOPS old, the previous answer stands until the new one arrives.
+     * A spot the game refuses is blocked in the placement grid for a while, so that it is not chosen again. A spot the
+     * game allows is freed of anything the grid still had covering it.
+     * 
+     * @param ability_id The ability that builds the structure
+     * @param point The center of the structure
+     * @return Whether the game allows the structure there, or std::nullopt until the game has answered
+     */
+    std::optional<bool> ConfirmPlacement(sc2::ABILITY_ID ability_id, const sc2::Point2D& point);
 
 private:
     sc2::Agent* bot;
@@ -181,9 +244,37 @@ private:
     std::vector<scdata::Ramp> m_Ramps;
     std::vector<sc2::Point3D> m_Expansions;
 
+    std::unique_ptr<ThreadPool> m_ThreadPool;
+    std::unique_ptr<Scheduler> m_Scheduler;
+    std::unique_ptr<PlacementGrid> m_PlacementGrid;
+    std::unique_ptr<PathingGrid> m_PathingGrid;
+    std::unique_ptr<QueryBroker> m_QueryBroker;
+
+    // Last spot checked with the game for an ability and its answer
+    struct PlacementConfirmation {
+        sc2::Point2D point;
+        // Game loop of the answer
+        uint32_t answered;
+        bool has_answer;
+        bool placeable;
+        // A query for the spot is waiting for the next flush
+        bool querying;
+    };
+
+    std::unordered_map<sc2::ABILITY_ID, PlacementConfirmation> m_PlacementConfirmations;
+
+    // Game loop at which the placement grid is next checked against the observation
+    uint32_t m_NextPlacementRefresh = 0;
+
     static sc2::Units s_EmptyUnits;
 
     void UpdateUnits();
+
+    // Reads the ramps and expansions from the cache of the map, or analyses the map and writes the cache
+    void LoadMapAnalysis();
+
+    // Writes the cache of the map on the thread pool, the ramps and expansions are copied when the routine starts
+    Routine WriteMapCache(std::string path, uint64_t hash);
 };
 
 }
\ No newline at end of file
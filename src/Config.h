@@ -20,3 +20,83 @@
 
 #define PROBE_RANGE 10.0f
 #define PROBE_RANGE_SQUARED PROBE_RANGE * PROBE_RANGE
+
+// Default memory budget of the macro search transposition table
+#define MACRO_TRANSPOSITION_SIZE_MB 64
+
+// Number of macro search threads, 0 uses all but one hardware thread
+#define MACRO_SEARCH_THREADS 0
+
+// Whether the macro search models production time, units complete as soon as they are started otherwise
+#define MACRO_TIMELINE_MODEL 1
+
+// Where to write the unit type table read by the macro benchmark at game start, not written when undefined
+//#define MACRO_UNIT_TYPES_DUMP "unit_types.txt"
+
+// Print the root state and root moves of every macro search, not printed when undefined
+//#define MACRO_DEBUG_OUTPUT
+
+// Whether the macro search uses principal variation search
+#define MACRO_PRINCIPAL_VARIATION_SEARCH 1
+
+// Half width of the macro search aspiration window, 0 searches every iteration with a full window
+#define MACRO_ASPIRATION_WINDOW 200.0
+
+// Whether the macro search reduces the depth of moves that are ordered late
+#define MACRO_LATE_MOVE_REDUCTIONS 1
+
+// Whether the macro search prunes nodes where passing is already good enough
+#define MACRO_NULL_MOVE_PRUNING 1
+
+// Algorithm of the macro search, 0 for alpha-beta, 1 for Monte Carlo tree search, 2 for beam search
+#define MACRO_SEARCH_BACKEND 0
+
+// Number of nodes in the pool of the Monte Carlo macro search tree
+#define MACRO_MONTE_CARLO_NODES (1 << 20)
+
+// Number of states the beam search keeps per time slice
+#define MACRO_BEAM_WIDTH 256
+
+// Longest wait in seconds of a macro search move that waits until its unit is affordable, 0 disables them
+#define MACRO_MAX_WAIT 60.0f
+
+// Number of threads of the bot-wide pool for background work, 0 uses all but one hardware thread
+#define BOT_WORKER_THREADS 2
+
+// Nodes the macro search visits between reads of its stop request, a power of two that bounds the latency of completing it
+#define MACRO_CANCELLATION_INTERVAL 1024
+
+// Milliseconds completing a macro search may take, MacroBench fails when a fixture goes over it
+#define MACRO_COMPLETE_BUDGET_MS 1.0
+
+// Opening book of the macro search that is mapped at game start, written by MacroBench --WriteBook. Not used when
+// undefined or when the file is missing.
+#define MACRO_OPENING_BOOK "opening_book.bin"
+
+// Cells around minerals and geysers where the local placement grid does not place structures, keeps the mineral
+// lines free and matches the distance the game enforces for town halls
+#define PLACEMENT_RESOURCE_MARGIN 3
+
+// Game loops a spot stays blocked in the local placement grid after the game refused it, about ten seconds
+#define PLACEMENT_REJECTION_LOOPS 224
+
+// Game loops an answer of the game to a placement query is used before it is asked again, about a second
+#define PLACEMENT_CONFIRMATION_LOOPS 22
+
+// Game loops between checks of the local placement grid against the observation, drops the structures that died out
+// of vision, about two seconds
+#define PLACEMENT_REFRESH_LOOPS 45
+
+// Smallest height difference between the ends of a pathable but not placeable region for it to be a ramp, flat
+// regions are decoration
+#define RAMP_MIN_HEIGHT_DIFFERENCE 0.5f
+
+// Smallest number of cells of a ramp
+#define RAMP_MIN_CELLS 8
+
+// Height from the highest or lowest cell of a ramp within which its cells belong to the top or bottom end
+#define RAMP_SIDE_TOLERANCE 0.5f
+
+// Directory of the caches of map analysis, one file per map written after the first game on it. The map is analysed
+// at every game start when undefined.
+#define MAP_CACHE_DIRECTORY "map_cache"
@@ -13,7 +13,18 @@ namespace scdata {
     
     struct Ramp
     {
+        // Center of mass of the cells of the ramp
         sc2::Point2D point;
+        // Centers of the cells at the upper and the lower end
+        sc2::Point2D top;
+        sc2::Point2D bottom;
+        // Bounding box of the cells, the maximum is exclusive
+        sc2::Point2D min;
+        sc2::Point2D max;
+        float top_height;
+        float bottom_height;
+        // Width of the narrower end in cells, across the direction of the ramp
+        float choke_width;
     };
 
     struct DelayedOrder
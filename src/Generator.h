@@ -1,9 +1,12 @@
 #pragma once
 
+#include <concepts>
 #include <coroutine>
 #include <cstdint>
 #include <exception>
+#include <functional>
 #include <iostream>
+#include <utility>
  
 template<typename T>
 struct Generator
@@ -79,4 +82,113 @@ private:
         }
     }
 };
- 
\ No newline at end of file
+ 
+/**
+ * @brief Waits a number of game steps when awaited in a Routine.
+ */
+struct NextStep
+{
+    uint32_t steps = 1;
+};
+
+/**
+ * @brief Fire-and-forget coroutine that is resumed on the game thread by a Scheduler.
+ *
+ * A routine runs until it awaits something that is not ready. Anything with a `bool IsReady() const` can be
+ * awaited, such as a Future of the ThreadPool, and the result of its `Get()` is returned by the co_await.
+ * NextStep suspends the routine for a number of game steps.
+ */
+struct Routine
+{
+    struct promise_type;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    struct promise_type
+    {
+        // Checked by the scheduler once per step, the routine is resumed once it returns true
+        std::function<bool()> ready_;
+        std::exception_ptr exception_;
+
+        Routine get_return_object()
+        {
+            return Routine(handle_type::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void unhandled_exception() { exception_ = std::current_exception(); }
+        void return_void() {}
+
+        template<typename Awaited>
+            requires requires(const Awaited& awaited) { { awaited.IsReady() } -> std::convertible_to<bool>; }
+        auto await_transform(Awaited awaited)
+        {
+            struct Awaiter
+            {
+                Awaited awaited_;
+                promise_type& promise_;
+
+                bool await_ready() const { return awaited_.IsReady(); }
+                void await_suspend(handle_type)
+                {
+                    promise_.ready_ = [awaited = awaited_]() { return awaited.IsReady(); };
+                }
+                decltype(auto) await_resume()
+                {
+                    promise_.ready_ = nullptr;
+
+                    if constexpr (requires { awaited_.Get(); }) {
+                        return awaited_.Get();
+                    }
+                }
+            };
+
+            return Awaiter{std::move(awaited), *this};
+        }
+
+        auto await_transform(NextStep next)
+        {
+            struct Awaiter
+            {
+                uint32_t steps_;
+                promise_type& promise_;
+
+                bool await_ready() const { return steps_ == 0; }
+                void await_suspend(handle_type)
+                {
+                    promise_.ready_ = [remaining = steps_]() mutable { return --remaining == 0; };
+                }
+                void await_resume() { promise_.ready_ = nullptr; }
+            };
+
+            return Awaiter{next.steps, *this};
+        }
+    };
+
+    handle_type h_;
+
+    Routine(handle_type h) : h_(h) {}
+    Routine(Routine&& other) noexcept : h_(std::exchange(other.h_, nullptr)) {}
+    Routine(const Routine&) = delete;
+    Routine& operator=(const Routine&) = delete;
+    ~Routine() { if (h_) h_.destroy(); }
+
+    /**
+     * @brief Resume the routine if what it awaits is ready.
+     *
+     * @note Rethrows the exception of the routine if it threw one
+     * @return true if the routine has finished, false otherwise
+     */
+    bool Step()
+    {
+        auto& promise = h_.promise();
+
+        if (!h_.done() && (!promise.ready_ || promise.ready_())) {
+            h_();
+        }
+
+        if (promise.exception_)
+            std::rethrow_exception(std::exchange(promise.exception_, nullptr));
+
+        return h_.done();
+    }
+};
@@ -1,7 +1,9 @@
 #include "Macro.h"
 
 #include "Data.h"
+#include "MonteCarloTree.h"
 #include "Utilities.h"
+#include "Zobrist.h"
 
 
 using namespace scdata;
@@ -10,15 +12,43 @@ using namespace scbot;
 // Should use Transposition?
 #define USE_TRANSPOSITION
 
-scbot::Macro::Macro(std::shared_ptr<Collective> collective)
+uint8_t scbot::GetMacroUnitIndex(sc2::UNIT_TYPEID type)
+{
+    static const auto lookup = []() {
+        std::array<uint8_t, 2048> table;
+        table.fill(InvalidMacroUnit);
+        for (size_t i = 0; i < MacroUnitCount; ++i) {
+            table[static_cast<size_t>(MacroUnitTypes[i])] = static_cast<uint8_t>(i);
+        }
+        return table;
+    }();
+
+    const auto id = static_cast<size_t>(type);
+
+    return id < lookup.size() ? lookup[id] : InvalidMacroUnit;
+}
+
+scbot::Macro::Macro(std::shared_ptr<Collective> collective) :
+    Macro(collective->Observation()->GetUnitTypeData())
 {
     m_Collective = collective;
+}
+
+scbot::Macro::Macro(const sc2::UnitTypes& unit_types) :
+    m_TranspositionTable(MACRO_TRANSPOSITION_SIZE_MB)
+{
+    m_Control = std::make_shared<SearchControl>();
+
+    m_UnitTypes = unit_types;
 
-    m_UnitTypes = m_Collective->Observation()->GetUnitTypeData();
+    BuildMoveTable();
+
+    SetSearchThreads(MACRO_SEARCH_THREADS);
 }
 
 scbot::Macro::~Macro()
 {
+    StopWorkers();
 }
 
 void scbot::Macro::OnStep()
@@ -27,358 +57,1455 @@ void scbot::Macro::OnStep()
 
 std::shared_ptr<MacroPromise> scbot::Macro::Search()
 {
-    auto cancellation_token = std::make_shared<bool>(false);
-    auto result = std::make_shared<MoveSequence>();
+    return Search(GetState());
+}
+
+std::shared_ptr<MacroPromise> scbot::Macro::Search(BoardState state)
+{
+    PrepareState(state);
+
+    // The book was searched deeper offline than there is time for now, its line is the result
+    MoveSequence book;
+    if (ProbeOpeningBook(state, book)) {
+        // The workers are not needed, but they should not keep writing the results of the previous root into the
+        // next search, which ages the table
+        {
+            std::unique_lock lock(m_Control->mutex);
+            m_Control->cancellation.request_stop();
+
+            m_Control->condition.wait(lock, [this]() { return m_Control->running == 0; });
+        }
+
+        auto statistics = std::make_shared<SearchStatistics>();
+        statistics->depth = book.depth;
+        statistics->book_moves = book.moves.size();
+
+        auto promise = std::make_shared<MacroPromise>();
+        promise->m_Snapshot = std::make_shared<ResultSnapshot>();
+        promise->m_Snapshot->sequence = std::make_shared<const MoveSequence>(book);
+        promise->m_Results.push_back(std::make_shared<MoveSequence>(book));
+        promise->m_Statistics.push_back(statistics);
+
+        return promise;
+    }
+
+    if (m_Workers.empty()) {
+        StartWorkers();
+    }
+
     auto promise = std::make_shared<MacroPromise>();
-    promise->m_CancellationToken = cancellation_token;
-    promise->m_Result = result;
-    auto in_state = GetState();
-    promise->m_Thread = std::thread([this, in_state, cancellation_token, result]() {
-        auto state = in_state;
-        GetBestMove(state, cancellation_token, result);
-    });;
+    promise->m_Control = m_Control;
+    promise->m_Snapshot = std::make_shared<ResultSnapshot>();
+
+    for (size_t i = 0; i < m_Workers.size(); ++i) {
+        promise->m_Results.push_back(std::make_shared<MoveSequence>());
+        promise->m_Statistics.push_back(std::make_shared<SearchStatistics>());
+    }
+
+    {
+        std::unique_lock lock(m_Control->mutex);
+
+        // Stop the previous root and wait for every worker to park before the table is aged
+        m_Control->cancellation.request_stop();
+
+        m_Control->condition.wait(lock, [this]() { return m_Control->running == 0; });
+
+        m_TranspositionTable.NewSearch();
+
+        // The Monte Carlo tree is not reused, its root would have to be found among the nodes of the old one
+        if (m_SearchOptions.backend == SearchBackend::MonteCarlo) {
+            if (m_Tree == nullptr) {
+                m_Tree = std::make_unique<MonteCarloTree>(MACRO_MONTE_CARLO_NODES);
+            }
+
+            m_Tree->Reset();
+        }
+
+        // The barrier is sized for the workers, which do not change while they are parked
+        if (m_SearchOptions.backend == SearchBackend::Beam) {
+            m_Beam = std::make_unique<BeamControl>(m_Workers.size());
+            m_Beam->states.push_back(state);
+        }
+
+        // Lazy SMP, every worker searches the same root and they share work through the transposition table
+        m_Control->root = state;
+        m_Control->options = m_SearchOptions;
+        m_Control->cancellation = promise->m_Cancellation;
+        m_Control->snapshot = promise->m_Snapshot;
+        m_Control->results = promise->m_Results;
+        m_Control->statistics = promise->m_Statistics;
+        m_Control->running = static_cast<uint32_t>(m_Workers.size());
+
+        promise->m_Generation = ++m_Control->generation;
+    }
+
+    m_Control->condition.notify_all();
+
     return promise;
 }
 
-MoveSequence Macro::SearchBuild(
-    int32_t depth,
-    double alpha,
-    double beta,
-    BoardState &state,
-    std::shared_ptr<bool> cancellation_token)
+void scbot::Macro::StartWorkers()
 {
-    if (*cancellation_token) {
-        return MoveSequence(EvaluateState(state), {});
+    // The principal variation table is too large for the stack of a thread on some platforms
+    while (m_Contexts.size() < m_SearchThreads) {
+        auto context = std::make_unique<SearchContext>();
+        context->id = static_cast<int32_t>(m_Contexts.size());
+        m_Contexts.push_back(std::move(context));
     }
 
-#ifdef USE_TRANSPOSITION
-    // Lookup transposition table to reuse results
-    MoveSequence ttResult;
-    if (LookupTranspositionTable(state, depth, alpha, beta, ttResult)) {
-        return ttResult;
+    m_Contexts.resize(m_SearchThreads);
+
+    uint64_t generation;
+    {
+        std::unique_lock lock(m_Control->mutex);
+        generation = m_Control->generation;
     }
-#endif
 
-    if (depth <= 0 || state.terminal) {
-        return MoveSequence(EvaluateState(state), {});
+    for (uint32_t i = 0; i < m_SearchThreads; ++i) {
+        m_Workers.emplace_back(&Macro::SearchWorker, this, i, generation);
     }
+}
 
-    // Get all possible moves for the current state
-    std::vector<Move> moves = GetPossibleMoves(state, 5.0f);
-    SortMoves(moves);  // Sort moves using heuristic
+void scbot::Macro::StopWorkers()
+{
+    if (m_Workers.empty()) {
+        return;
+    }
 
-    MoveSequence bestSequence(state.turn ? -INFINITY : INFINITY);  // Max for player, Min for opponent
+    {
+        std::unique_lock lock(m_Control->mutex);
+        m_Control->shutdown = true;
+        m_Control->cancellation.request_stop();
+    }
 
-    for (const Move& move : moves) {
-        auto oldState = state;
+    m_Control->condition.notify_all();
 
-        MakeMove(state, move);
+    for (auto& worker : m_Workers) {
+        worker.join();
+    }
 
-        // Recursively search with reduced depth
-        MoveSequence result = SearchBuild(depth - 1, alpha, beta, state, cancellation_token);
+    m_Workers.clear();
 
-        if (!move.nullmove) {
-            int i = 0;
+    // Workers finish a root they were handed before they exit, so nobody is left waiting on them
+    {
+        std::unique_lock lock(m_Control->mutex);
+        m_Control->shutdown = false;
+        m_Control->running = 0;
+    }
+
+    m_Control->condition.notify_all();
+}
+
+void scbot::Macro::SearchWorker(uint32_t id, uint64_t generation)
+{
+    auto& context = *m_Contexts[id];
+
+    while (true) {
+        BoardState state;
+        std::shared_ptr<MoveSequence> result;
+        std::shared_ptr<SearchStatistics> statistics;
+
+        {
+            std::unique_lock lock(m_Control->mutex);
+
+            m_Control->condition.wait(lock, [this, generation]() {
+                return m_Control->shutdown || m_Control->generation != generation;
+            });
+
+            // A root handed over just before shutdown is still picked up. Its search is cancelled already and ends at
+            // once, but a beam search needs every worker at its barrier or the others never get past it.
+            if (m_Control->shutdown && m_Control->generation == generation) {
+                return;
+            }
+
+            generation = m_Control->generation;
+            state = m_Control->root;
+            result = m_Control->results[id];
+            statistics = m_Control->statistics[id];
+            context.cancellation = m_Control->cancellation;
+            context.snapshot = m_Control->snapshot;
+            context.options = m_Control->options;
         }
 
-        UnmakeMove(state, move);
+        context.statistics = SearchStatistics();
+        context.stopped = false;
+        context.null_move.fill(false);
 
-        result.moves.insert(result.moves.begin(), move);
+        // Killers belong to the positions of the old root, history is only aged so that it carries over
+        for (auto& killers : context.killers) {
+            killers.fill(TranspositionTable::NoMove);
+        }
 
-        // Update best score and alpha-beta bounds
-        if (state.turn) {  // Maximizing player
-            if (result.score > bestSequence.score) {
-                bestSequence = result;
+        for (auto& side : context.history) {
+            for (auto& entry : side) {
+                entry /= 2;
             }
-            alpha = std::max(alpha, bestSequence.score);
-        } else {  // Minimizing player
-            if (result.score < bestSequence.score) {
-                bestSequence = result;
+        }
+
+        if (context.options.backend == SearchBackend::MonteCarlo) {
+            SearchMonteCarlo(state, context, result);
+        } else if (context.options.backend == SearchBackend::Beam) {
+            SearchBeam(state, context, result);
+        } else {
+            GetBestMove(state, context, result);
+        }
+
+        *statistics = context.statistics;
+
+        {
+            std::unique_lock lock(m_Control->mutex);
+            --m_Control->running;
+        }
+
+        m_Control->condition.notify_all();
+    }
+}
+
+const MacroUnitTraits& scbot::GetMacroUnitTraits(uint8_t index)
+{
+    static const auto traits = []() {
+        std::array<MacroUnitTraits, MacroUnitCount> table {};
+        for (size_t i = 0; i < MacroUnitCount; ++i) {
+            const auto type = MacroUnitTypes[i];
+            auto& entry = table[i];
+
+            switch (type) {
+                case sc2::UNIT_TYPEID::PROTOSS_PROBE:
+                    entry.workers = 1;
+                    break;
+                case sc2::UNIT_TYPEID::PROTOSS_ASSIMILATOR:
+                    entry.extractors = 1;
+                    break;
+                case sc2::UNIT_TYPEID::PROTOSS_NEXUS:
+                    entry.bases = 1;
+                    entry.supply = 15;
+                    break;
+                case sc2::UNIT_TYPEID::PROTOSS_PYLON:
+                    entry.supply = 8;
+                    break;
+                default:
+                    break;
+            }
+
+            const auto& ability_it = UnitToAbility.find(type);
+
+            if (ability_it == UnitToAbility.end()) {
+                continue;
+            }
+
+            const auto& ability = ability_it->second;
+
+            const auto& supply_it = UnitSupply.find(ability);
+
+            if (supply_it != UnitSupply.end()) {
+                const auto& supply = supply_it->second;
+
+                entry.material += supply * (ability == sc2::ABILITY_ID::TRAIN_PROBE ? 50 : 400);
+
+                entry.supply -= supply;
+                entry.supply_cost = supply;
+            }
+
+            // Supply structures are valued through the supply they allow instead of their cost
+            const auto& ability_cost_it = AbilityCosts.find(ability);
+
+            if (ability_cost_it != AbilityCosts.end() && ability != sc2::ABILITY_ID::BUILD_PYLON) {
+                const auto& cost = ability_cost_it->second;
+
+                entry.material += cost.minerals + cost.vespene * 1.5;
             }
-            beta = std::min(beta, bestSequence.score);
         }
+        return table;
+    }();
 
-        // Prune the branch if alpha-beta cutoff is reached
-        if (beta <= alpha) {
-            break;
+    return traits[index];
+}
+
+void scbot::Macro::AddUnitAggregates(PlayerState& player, uint8_t index, int32_t count)
+{
+    const auto& traits = GetMacroUnitTraits(index);
+
+    player.workers += traits.workers * count;
+    player.extractors += traits.extractors * count;
+    player.bases += traits.bases * count;
+    player.supply += traits.supply * count;
+    player.material += traits.material * count;
+}
+
+void scbot::Macro::AddPlannedAggregates(PlayerState& player, uint8_t index, int32_t count)
+{
+    const auto& traits = GetMacroUnitTraits(index);
+
+    player.planned_workers += traits.workers * count;
+    player.planned_extractors += traits.extractors * count;
+    player.planned_bases += traits.bases * count;
+    player.planned_supply += traits.supply_cost * count;
+    player.planned_material += traits.material * count;
+}
+
+void scbot::Macro::ComputeAggregates(PlayerState& player)
+{
+    player.owned = 0;
+    player.workers = 0;
+    player.extractors = 0;
+    player.bases = 0;
+    player.supply = 0;
+    player.material = 0.0;
+    player.planned_workers = 0;
+    player.planned_extractors = 0;
+    player.planned_bases = 0;
+    player.planned_supply = 0;
+    player.planned_material = 0.0;
+
+    for (size_t i = 0; i < MacroUnitCount; ++i) {
+        if (player.units[i] != 0) {
+            player.owned |= uint64_t(1) << i;
+            AddUnitAggregates(player, static_cast<uint8_t>(i), player.units[i]);
+        }
+
+        if (player.planned_units[i] != 0) {
+            AddPlannedAggregates(player, static_cast<uint8_t>(i), player.planned_units[i]);
+        }
+    }
+}
+
+void scbot::Macro::ChangeUnitCount(BoardState& state, bool friendly, uint8_t index, int32_t count)
+{
+    auto& player = friendly ? state.friendly_units : state.enemy_units;
+    auto& units = player.units[index];
+    const auto type = MacroUnitTypes[index];
+
+    state.hash ^= Zobrist::UnitKey(friendly, type, units);
+    units += count;
+    state.hash ^= Zobrist::UnitKey(friendly, type, units);
+
+    if (units == 0) {
+        player.owned &= ~(uint64_t(1) << index);
+    } else {
+        player.owned |= uint64_t(1) << index;
+    }
+
+    AddUnitAggregates(player, index, count);
+}
+
+void scbot::Macro::ChangePlannedCount(BoardState& state, bool friendly, uint8_t index, int32_t count)
+{
+    auto& player = friendly ? state.friendly_units : state.enemy_units;
+    auto& planned = player.planned_units[index];
+    const auto type = MacroUnitTypes[index];
+
+    state.hash ^= Zobrist::PlannedKey(friendly, type, planned);
+    planned += count;
+    state.hash ^= Zobrist::PlannedKey(friendly, type, planned);
+
+    AddPlannedAggregates(player, index, count);
+}
+
+namespace {
+
+// Heap order for the pending units, the unit that completes first is on top
+bool CompletesLater(const PendingUnit& a, const PendingUnit& b)
+{
+    return a.complete_time > b.complete_time;
+}
+
+// History entries stay within +-HistoryMax
+constexpr int32_t HistoryMax = 16384;
+
+// Ordering scores of the transposition table move and the killers, above any history and static score
+constexpr double TTMoveScore = 1e9;
+constexpr double KillerScore = 1e8;
+
+size_t HistoryIndex(const Move& move)
+{
+    return move.nullmove ? MacroUnitCount : move.index;
+}
+
+void UpdateHistory(int32_t& entry, int32_t bonus)
+{
+    // Gravity towards the bonus, entries saturate instead of having to rescale the table
+    entry += bonus - entry * std::abs(bonus) / HistoryMax;
+}
+
+// Minerals and vespene a gathering worker brings in per second
+constexpr float MineralRate = 1.256f;
+constexpr float VespeneRate = 0.94f;
+
+// Set in encoded moves that wait until the unit is affordable
+constexpr uint16_t WaitMoveBit = 0x8000;
+
+// Only completed units gather, vespene is saturated first
+void GetGatherers(const PlayerState& player, int32_t& mineral_workers, int32_t& vespene_workers)
+{
+    vespene_workers = std::min<int32_t>(player.extractors * 3, player.workers);
+    mineral_workers = std::min<int32_t>(player.bases * 12, player.workers - vespene_workers);
+}
+
+// Playouts between the checks of the main Monte Carlo thread for the depth of the best line
+constexpr uint64_t LineCheckInterval = 256;
+
+// Nodes between the reads of the stop request by the alpha-beta search, a power of two
+constexpr uint64_t CancellationMask = MACRO_CANCELLATION_INTERVAL - 1;
+static_assert((MACRO_CANCELLATION_INTERVAL & CancellationMask) == 0, "MACRO_CANCELLATION_INTERVAL must be a power of two");
+
+// The request is written by another thread, reading it costs a cache miss once it is. Between the reads the
+// flag of the context is used, which the compiler is free to keep in a register.
+bool PollCancellation(SearchContext& context, bool force)
+{
+    if (!context.stopped && (force || (context.statistics.nodes & CancellationMask) == 0)) {
+        context.stopped = context.cancellation.stop_requested();
+    }
+
+    return context.stopped;
+}
+
+// Lines of the same depth replace each other so that the snapshot follows the latest iteration. The Monte Carlo
+// line can get shorter as the visits shift, it replaces the snapshot unconditionally.
+void PublishResult(ResultSnapshot& snapshot, const MoveSequence& sequence, bool deeper_only)
+{
+    const auto published = std::make_shared<const MoveSequence>(sequence);
+
+    auto current = std::atomic_load_explicit(&snapshot.sequence, std::memory_order_acquire);
+
+    do {
+        if (deeper_only && current != nullptr && current->depth > sequence.depth) {
+            return;
+        }
+    } while (!std::atomic_compare_exchange_weak_explicit(
+        &snapshot.sequence, &current, published, std::memory_order_release, std::memory_order_acquire));
+}
+
+// xorshift64*, playouts only need cheap numbers that differ between threads
+uint64_t NextRandom(uint64_t& state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1Dull;
+}
+
+}
+
+void scbot::Macro::AdvanceTimeline(BoardState& state, bool friendly, float time)
+{
+    auto& player = friendly ? state.friendly_units : state.enemy_units;
+    const auto begin = player.pending.begin();
+
+    // Only the units that complete are touched, each costs a heap pop
+    while (player.pending_count != 0 && player.pending[0].complete_time <= time) {
+        std::pop_heap(begin, begin + player.pending_count, CompletesLater);
+        const auto unit = player.pending[--player.pending_count];
+
+        ChangePlannedCount(state, friendly, unit.index, -1);
+        ChangeUnitCount(state, friendly, unit.index, 1);
+
+        ASSERT(player.completed_count < MacroMaxCompleted);
+        player.completed[player.completed_count++] = unit;
+    }
+}
+
+void scbot::Macro::RewindTimeline(BoardState& state, bool friendly, float time)
+{
+    auto& player = friendly ? state.friendly_units : state.enemy_units;
+    const auto begin = player.pending.begin();
+
+    // Completions are logged in time order, everything after the given time is on top of the log
+    while (player.completed_count != 0 && player.completed[player.completed_count - 1].complete_time > time) {
+        const auto unit = player.completed[--player.completed_count];
+
+        ChangeUnitCount(state, friendly, unit.index, -1);
+        ChangePlannedCount(state, friendly, unit.index, 1);
+
+        ASSERT(player.pending_count < MacroMaxPending);
+        player.pending[player.pending_count++] = unit;
+        std::push_heap(begin, begin + player.pending_count, CompletesLater);
+    }
+}
+
+void scbot::Macro::BuildMoveTable()
+{
+    m_MoveTable.clear();
+
+    for (const auto& [ability, requirements] : AbilityRequirements) {
+        const auto& cost_it = AbilityCosts.find(ability);
+        const auto& unit_it = AbilityToUnit.find(ability);
+
+        if (cost_it == AbilityCosts.end() || unit_it == AbilityToUnit.end()) {
+            continue;
+        }
+
+        const auto index = GetMacroUnitIndex(unit_it->second);
+
+        if (index == InvalidMacroUnit) {
+            continue;
+        }
+
+        // Abilities requiring a unit the search does not track can never be used
+        uint64_t mask = 0;
+        bool valid = true;
+        for (const auto& type : requirements) {
+            const auto requirement = GetMacroUnitIndex(type);
+            if (requirement == InvalidMacroUnit) {
+                valid = false;
+                break;
+            }
+            mask |= uint64_t(1) << requirement;
+        }
+
+        if (!valid) {
+            continue;
         }
 
-        if (*cancellation_token) {
-            break;
-        }
-    }
+        const auto& supply_it = UnitSupply.find(ability);
+        const auto& unit_data = m_UnitTypes.at(sc2::UnitTypeID(unit_it->second));
+
+        MoveTemplate entry;
+        entry.ability = ability;
+        entry.unit = unit_it->second;
+        entry.index = index;
+        entry.requirements = mask;
+        entry.cost = cost_it->second;
+        entry.supply = supply_it != UnitSupply.end() ? supply_it->second : 0;
+        // A unit must complete strictly after it was started, otherwise UnmakeMove can not tell it apart
+        // from units that completed during earlier moves
+        entry.build_time = std::max(Utilities::ToSecondsFromGameTime(unit_data.build_time), Utilities::ToSecondsFromGameTime(1.0f));
+
+        m_MoveTable.push_back(entry);
+    }
+
+    // The requirement map is unordered, sort so that move generation is deterministic
+    std::sort(m_MoveTable.begin(), m_MoveTable.end(), [](const MoveTemplate& a, const MoveTemplate& b) {
+        return a.ability < b.ability;
+    });
+
+    // The static heuristic only depends on the unit, so it is computed once here instead of while sorting
+    for (size_t i = 0; i < MacroUnitCount; ++i) {
+        m_MoveHeuristics[i] = MoveHeuristic({false, MacroUnitTypes[i], static_cast<uint8_t>(i), {}, 0.0f, 0.0f, 0.0f, 0.0f});
+    }
+
+    m_MoveHeuristics[MacroUnitCount] = MoveHeuristic({true, sc2::UNIT_TYPEID::INVALID, InvalidMacroUnit, {}, 0.0f, 0.0f, 0.0f, 0.0f});
+}
+
+void scbot::Macro::SetTranspositionTableSize(size_t megabytes)
+{
+    StopWorkers();
+
+    m_TranspositionTable.Resize(megabytes);
+}
+
+void scbot::Macro::SetSearchThreads(uint32_t threads)
+{
+    StopWorkers();
+
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    m_SearchThreads = threads;
+}
+
+void scbot::Macro::SetMaxDepth(int32_t depth)
+{
+    m_SearchOptions.max_depth = std::clamp(depth, 1, MacroMaxPly - 2);
+}
+
+void scbot::Macro::SetSearchOptions(const SearchOptions& options)
+{
+    m_SearchOptions = options;
+    SetMaxDepth(options.max_depth);
+}
+
+const SearchOptions& scbot::Macro::GetSearchOptions() const
+{
+    return m_SearchOptions;
+}
+
+void scbot::Macro::SetOpeningBook(std::shared_ptr<const OpeningBook> book)
+{
+    m_OpeningBook = std::move(book);
+}
+
+std::vector<OpeningBookEntry> scbot::Macro::GetOpeningBookEntries(BoardState state, const MoveSequence& sequence)
+{
+    PrepareState(state);
+
+    std::vector<OpeningBookEntry> entries;
+    entries.reserve(sequence.moves.size());
+
+    // Every position along the line was searched that much shallower than the root
+    for (size_t i = 0; i < sequence.moves.size(); ++i) {
+        const auto depth = std::max<int32_t>(sequence.depth - static_cast<int32_t>(i), 0);
+
+        entries.push_back({state.hash, EncodeMove(sequence.moves[i]), static_cast<uint16_t>(depth), 0});
+
+        MakeMove(state, sequence.moves[i]);
+    }
+
+    return entries;
+}
+
+double Macro::SearchBuild(
+    int32_t depth,
+    double alpha,
+    double beta,
+    BoardState &state,
+    SearchContext& context,
+    int32_t ply)
+{
+    ++context.statistics.nodes;
+
+    context.pv_length[ply] = 0;
+
+    if (PollCancellation(context, false)) {
+        return EvaluateState(state);
+    }
+
+    uint16_t ttMove = TranspositionTable::NoMove;
+
+#ifdef USE_TRANSPOSITION
+    // Lookup transposition table to reuse results, or at least to try its best move first
+    double ttScore;
+    if (LookupTranspositionTable(state, depth, alpha, beta, ttScore, ttMove, context.statistics)) {
+        return ttScore;
+    }
+#endif
+
+    if (depth <= 0 || state.terminal || ply >= MacroMaxPly - 1) {
+        return EvaluateState(state);
+    }
+
+    // If passing is already good enough for the side to move there is no need to look at its builds
+    double nullScore;
+    if (TryNullMove(depth, alpha, beta, state, context, ply, nullScore)) {
+        return nullScore;
+    }
+
+    const double alphaOriginal = alpha;
+    const double betaOriginal = beta;
+
+    // Get all possible moves for the current state
+    std::vector<Move> moves = GetPossibleMoves(state, 5.0f, context.options.max_wait);
+    SortMoves(moves, context, ply, state.turn, ttMove);
+
+    double bestScore = state.turn ? -INFINITY : INFINITY;  // Max for player, Min for opponent
+    uint16_t bestMove = TranspositionTable::NoMove;
+
+    for (size_t i = 0; i < moves.size(); ++i) {
+        const Move& move = moves[i];
+
+        // Moves ordered late rarely turn out best, they are searched with less depth first
+        int32_t reduction = 0;
+        if (context.options.late_move_reductions && depth >= context.options.reduction_depth && i >= context.options.reduction_moves) {
+            reduction = (depth >= 6 && i >= context.options.reduction_moves * 3) ? 2 : 1;
+        }
+
+        MakeMove(state, move);
+
+        // Recursively search with reduced depth
+        const double score = SearchChild(depth - 1, alpha, beta, state, context, ply + 1, i == 0, reduction);
+
+        UnmakeMove(state, move);
+
+        // Update best score and alpha-beta bounds
+        if (state.turn ? score > bestScore : score < bestScore) {
+            bestScore = score;
+            bestMove = EncodeMove(move);
+            UpdatePrincipalVariation(context, ply, move);
+        }
+
+        if (state.turn) {  // Maximizing player
+            alpha = std::max(alpha, bestScore);
+        } else {  // Minimizing player
+            beta = std::min(beta, bestScore);
+        }
+
+        // Prune the branch if alpha-beta cutoff is reached
+        if (beta <= alpha) {
+            RecordCutoff(context, ply, state.turn, moves, i, depth);
+            break;
+        }
+
+        if (context.stopped) {
+            break;
+        }
+    }
+
+#ifdef USE_TRANSPOSITION
+    // Save the result to the transposition table before returning, unless the search was cut short
+    if (!context.stopped) {
+        SaveToTranspositionTable(state, bestScore, depth, alphaOriginal, betaOriginal, bestMove);
+    }
+#endif
+
+    return bestScore;
+}
+
+double Macro::SearchChild(
+    int32_t depth,
+    double alpha,
+    double beta,
+    BoardState& state,
+    SearchContext& context,
+    int32_t ply,
+    bool first,
+    int32_t reduction)
+{
+    // The move has been made, so the parent is the side that is not to move
+    const bool maximizing = !state.turn;
+    const double width = context.options.null_window;
+
+    // The first move is expected to be the best, there is no bound to prove the others against without it
+    if (first || (maximizing ? alpha == -INFINITY : beta == INFINITY)) {
+        return SearchBuild(depth, alpha, beta, state, context, ply);
+    }
+
+    if (reduction > 0) {
+        ++context.statistics.reductions;
+
+        const uint64_t nodes = context.statistics.nodes;
+
+        const double score = maximizing ?
+            SearchBuild(depth - reduction, alpha, std::min(alpha + width, beta), state, context, ply) :
+            SearchBuild(depth - reduction, std::max(beta - width, alpha), beta, state, context, ply);
+
+        // Confirmed to be no better than the best so far, the full depth search is saved
+        if (context.stopped || (maximizing ? score <= alpha : score >= beta)) {
+            context.statistics.reduction_nodes += context.statistics.nodes - nodes;
+            return score;
+        }
+
+        ++context.statistics.reduction_researches;
+    }
+
+    if (!context.options.principal_variation) {
+        return SearchBuild(depth, alpha, beta, state, context, ply);
+    }
+
+    ++context.statistics.pvs_searches;
+
+    // Only prove that the move is not better than the best so far, which a null window does cheaply
+    double score = maximizing ?
+        SearchBuild(depth, alpha, std::min(alpha + width, beta), state, context, ply) :
+        SearchBuild(depth, std::max(beta - width, alpha), beta, state, context, ply);
+
+    // The move might be better after all, find its exact score
+    if (score > alpha && score < beta && !context.stopped) {
+        ++context.statistics.pvs_researches;
+        score = SearchBuild(depth, alpha, beta, state, context, ply);
+    }
+
+    return score;
+}
+
+double Macro::SearchRoot(
+    int32_t depth,
+    double alpha,
+    double beta,
+    BoardState& state,
+    SearchContext& context,
+    const std::vector<Move>& moves)
+{
+    double bestScore = state.turn ? -INFINITY : INFINITY;  // Max for player, Min for opponent
+    context.pv_length[0] = 0;
+
+    for (size_t i = 0; i < moves.size(); ++i) {
+        const Move& move = moves[i];
+
+        MakeMove(state, move);
+
+        // Search for the best move sequence with time control
+        const double score = SearchChild(depth, alpha, beta, state, context, 1, i == 0, 0);
+
+        UnmakeMove(state, move);
+
+        // Update best line based on the current player's turn
+        if (state.turn ? score > bestScore : score < bestScore) {
+            bestScore = score;
+            UpdatePrincipalVariation(context, 0, move);
+        }
+
+        if (state.turn) {
+            alpha = std::max(alpha, bestScore);
+        } else {
+            beta = std::min(beta, bestScore);
+        }
+
+        // Only happens with an aspiration window, the iteration is repeated with a wider one
+        if (beta <= alpha) {
+            break;
+        }
+
+        if (context.stopped) {
+            break;
+        }
+    }
+
+    return bestScore;
+}
+
+bool Macro::TryNullMove(
+    int32_t depth,
+    double alpha,
+    double beta,
+    BoardState& state,
+    SearchContext& context,
+    int32_t ply,
+    double& outScore)
+{
+    const bool maximizing = state.turn;
+
+    // Two passes in a row only shorten the search, and a pass can only prove something against a finite bound
+    if (!context.options.null_move_pruning || depth < context.options.null_move_depth || context.null_move[ply] ||
+        (maximizing ? beta == INFINITY : alpha == -INFINITY)) {
+        return false;
+    }
+
+    ++context.statistics.null_moves;
+
+    const uint64_t nodes = context.statistics.nodes;
+    const double width = context.options.null_window;
+    const int32_t reduced = std::max(depth - 1 - context.options.null_move_reduction, 0);
+    const Move pass = GetPassMove(state, 5.0f);
+
+    MakeMove(state, pass);
+    context.null_move[ply + 1] = true;
+
+    const double score = maximizing ?
+        SearchBuild(reduced, std::max(beta - width, alpha), beta, state, context, ply + 1) :
+        SearchBuild(reduced, alpha, std::min(alpha + width, beta), state, context, ply + 1);
+
+    context.null_move[ply + 1] = false;
+    UnmakeMove(state, pass);
+
+    context.statistics.null_move_nodes += context.statistics.nodes - nodes;
+
+    if (context.stopped || (maximizing ? score < beta : score > alpha)) {
+        return false;
+    }
+
+    ++context.statistics.null_move_cutoffs;
+
+    outScore = score;
+
+    return true;
+}
+
+void Macro::RecordCutoff(SearchContext& context, int32_t ply, bool friendly, const std::vector<Move>& moves, size_t cutoff, int32_t depth)
+{
+    const auto& move = moves[cutoff];
+    const auto encoded = EncodeMove(move);
+
+    auto& killers = context.killers[ply];
+    if (killers[0] != encoded) {
+        killers[1] = killers[0];
+        killers[0] = encoded;
+    }
+
+    // Reward the move that caused the cutoff and punish the ones that were tried before it
+    auto& history = context.history[friendly];
+    const int32_t bonus = std::min(depth * depth, HistoryMax);
+
+    UpdateHistory(history[HistoryIndex(move)], bonus);
+
+    for (size_t i = 0; i < cutoff; ++i) {
+        UpdateHistory(history[HistoryIndex(moves[i])], -bonus);
+    }
+}
+
+void Macro::UpdatePrincipalVariation(SearchContext& context, int32_t ply, const Move& move)
+{
+    // The line is the move followed by the best line of the child, which was just written one row below
+    auto& line = context.pv[ply];
+    const auto& child = context.pv[ply + 1];
+    const int32_t child_length = context.pv_length[ply + 1];
+
+    line[0] = move;
+    std::copy(child.begin(), child.begin() + child_length, line.begin() + 1);
+    context.pv_length[ply] = child_length + 1;
+}
+
+
+double Macro::EvaluateState(BoardState& state) {
+    double score = 0.0;
+
+    if (state.terminal) {
+        return state.turn ? -INFINITY : INFINITY;
+    }
+    
+    auto& friendly = state.friendly_units;
+    auto& enemy = state.enemy_units;
+
+    score += EvaluatePlayer(friendly, enemy);
+    score -= EvaluatePlayer(enemy, friendly);
+
+    return score;
+}
+
+void Macro::MakeMove(BoardState &state, const Move &move)
+{
+    const auto friendly = state.turn;
+    auto& current = friendly ? state.friendly_units : state.enemy_units;
+    const auto& current_time = current.time;
+    const auto& next_time = current_time + move.delta_time;
+
+    // Remove the keys of the old resources and time, they are added back once updated.
+    state.hash ^= Zobrist::ResourceKey(friendly, current.resources) ^ Zobrist::TimeKey(friendly, current_time);
+
+    current.resources = current.resources + move.cost;
+
+    if (state.simple) {
+        if (!move.nullmove) {
+            ChangeUnitCount(state, friendly, move.index, 1);
+        }
+    } else {
+        if (!move.nullmove) {
+            ChangePlannedCount(state, friendly, move.index, 1);
+
+            const auto begin = current.pending.begin();
+            ASSERT(current.pending_count < MacroMaxPending);
+            current.pending[current.pending_count++] = {move.complete_time, move.index};
+            std::push_heap(begin, begin + current.pending_count, CompletesLater);
+        }
+
+        // Complete everything that finishes during this time step
+        AdvanceTimeline(state, friendly, next_time);
+    }
+
+    current.time = next_time;
+    state.turn = !state.turn;
+
+    state.hash ^= Zobrist::ResourceKey(friendly, current.resources) ^ Zobrist::TimeKey(friendly, current.time);
+    state.hash ^= Zobrist::TurnKey();
+}
+
+void Macro::UnmakeMove(BoardState &state, const Move &move)
+{
+    // First, toggle back the turn since the turn was switched at the end of MakeMove.
+    state.turn = !state.turn;
+    const auto friendly = state.turn;
+    auto& current = friendly ? state.friendly_units : state.enemy_units;
+
+    state.hash ^= Zobrist::TurnKey();
+    state.hash ^= Zobrist::ResourceKey(friendly, current.resources) ^ Zobrist::TimeKey(friendly, current.time);
+    
+    // Restore the time the move was made at, so that the time key and the rewind see exactly the old time
+    const auto prev_time = move.start_time;
+    current.time = prev_time;
+
+    // Reverse the resource addition by subtracting the move's cost.
+    current.resources = current.resources - move.cost;
+
+    if (state.simple) {
+        if (!move.nullmove) {
+            ChangeUnitCount(state, friendly, move.index, -1);
+        }
+    } else {
+        // Put back everything that completed during this time step
+        RewindTimeline(state, friendly, prev_time);
+
+        if (!move.nullmove) {
+            ChangePlannedCount(state, friendly, move.index, -1);
+
+            // Move the unit of this move to the top of the heap and pop it
+            const auto begin = current.pending.begin();
+            const auto end = begin + current.pending_count;
+            const auto it = std::find_if(begin, end, [&move](const PendingUnit& unit) {
+                return unit.index == move.index && unit.complete_time == move.complete_time;
+            });
+
+            ASSERT(it != end);
+
+            it->complete_time = -INFINITY;
+            std::push_heap(begin, it + 1, CompletesLater);
+            std::pop_heap(begin, end, CompletesLater);
+            --current.pending_count;
+        }
+    }
+
+    state.hash ^= Zobrist::ResourceKey(friendly, current.resources) ^ Zobrist::TimeKey(friendly, current.time);
+}
+
+std::vector<Move> Macro::GetPossibleMoves(BoardState &state, float timestep, float max_wait)
+{
+    std::vector<Move> moves;
+
+    auto& current = state.turn ? state.friendly_units : state.enemy_units;
+
+    const auto& current_time = current.time;
+
+    // Aggregates are kept up to date by MakeMove/UnmakeMove, units in production count towards the limits
+    const uint32_t num_workers = current.workers + current.planned_workers;
+    const uint32_t num_extractors = current.extractors + current.planned_extractors;
+    const uint32_t num_bases = current.bases + current.planned_bases;
+    const int32_t num_supply = current.supply - current.planned_supply;
+
+    const ResourcePair resources = GetIncome(current, timestep);
+
+    // Every unit in production completes at some point, the timeline model has no room for more once either log is full
+    const bool full = !state.simple && (current.pending_count >= MacroMaxPending ||
+        current.pending_count + current.completed_count >= MacroMaxCompleted);
+
+    // Generate all possible moves
+    for (const auto& entry : m_MoveTable) {
+        if (full) {
+            break;
+        }
+
+        if (entry.ability == sc2::ABILITY_ID::TRAIN_PROBE) {
+            if (num_workers >= (num_bases * 12 + num_extractors * 3)) {
+                continue;
+            }
+        }
+
+        if (entry.ability == sc2::ABILITY_ID::BUILD_ASSIMILATOR) {
+            if (num_extractors >= num_bases * 2) {
+                continue;
+            }
+        }
+
+        // If we have more than 8 free supply, don't build pylons
+        if (entry.ability == sc2::ABILITY_ID::BUILD_PYLON) {
+            if (num_supply >= 8) {
+                continue;
+            }
+        }
+
+        // Check if we have the required units
+        if ((current.owned & entry.requirements) != entry.requirements) {
+            continue;
+        }
+
+        if (entry.supply > 0 && num_supply < entry.supply) {
+            continue;
+        }
+
+        if (current.resources.minerals >= entry.cost.minerals && current.resources.vespene >= entry.cost.vespene) {
+            moves.push_back({false, entry.unit, entry.index, resources - entry.cost, current_time + entry.build_time, 5.0f, 0.0f, current_time});
+            continue;
+        }
+
+        // Not affordable yet, jump to the moment it is instead of passing until then
+        const float wait = max_wait > 0.0f ? GetAffordableWait(current, entry.cost) : INFINITY;
+
+        if (wait > max_wait) {
+            continue;
+        }
+
+        moves.push_back({false, entry.unit, entry.index, GetIncome(current, wait + timestep) - entry.cost, current_time + wait + entry.build_time, wait + timestep, wait, current_time});
+    }
+
+    // Can always pass
+    moves.push_back(GetPassMove(state, timestep));
+
+    return moves;
+}
+
+ResourcePair Macro::GetIncome(const PlayerState& player, float timestep)
+{
+    int32_t mineral_workers;
+    int32_t vespene_workers;
+    GetGatherers(player, mineral_workers, vespene_workers);
+
+    int32_t vespene_income = std::ceilf(vespene_workers * VespeneRate * timestep);
+    int32_t mineral_income = std::ceilf(mineral_workers * MineralRate * timestep);
+
+    return {mineral_income, vespene_income};
+}
+
+float Macro::GetAffordableWait(const PlayerState& player, const ResourcePair& cost)
+{
+    int32_t mineral_workers;
+    int32_t vespene_workers;
+    GetGatherers(player, mineral_workers, vespene_workers);
+
+    const int32_t minerals = cost.minerals - player.resources.minerals;
+    const int32_t vespene = cost.vespene - player.resources.vespene;
+
+    // Income is constant until the next move, so the wait is the larger of the two shortfalls over their rates
+    float wait = 0.0f;
+
+    if (minerals > 0) {
+        if (mineral_workers == 0) {
+            return INFINITY;
+        }
+
+        wait = std::max(wait, minerals / (mineral_workers * MineralRate));
+    }
+
+    if (vespene > 0) {
+        if (vespene_workers == 0) {
+            return INFINITY;
+        }
+
+        wait = std::max(wait, vespene / (vespene_workers * VespeneRate));
+    }
+
+    // Units can only be started on a game step
+    const float step = Utilities::ToSecondsFromGameTime(1.0f);
+    wait = std::ceil(wait / step) * step;
+
+    // Rounding can leave the income a mineral short, one more step always covers it
+    const auto income = GetIncome(player, wait);
+
+    if (player.resources.minerals + income.minerals < cost.minerals || player.resources.vespene + income.vespene < cost.vespene) {
+        wait += step;
+    }
+
+    return wait;
+}
+
+Move Macro::GetPassMove(const BoardState& state, float timestep)
+{
+    const auto& current = state.turn ? state.friendly_units : state.enemy_units;
+
+    return {true, sc2::UNIT_TYPEID::INVALID, InvalidMacroUnit, GetIncome(current, timestep), 0.0f, timestep, 0.0f, current.time};
+}
+
+// Modified GetBestMove function with time control and iterative deepening
+void Macro::GetBestMove(
+    BoardState& state, 
+    SearchContext& context,
+    std::shared_ptr<MoveSequence> result_ptr
+) {
+    // Start with a shallow depth and increase iteratively, helper threads are staggered by one ply
+    int32_t depth = 1 + context.id % 2;
+    *result_ptr = MoveSequence(state.turn ? -INFINITY : INFINITY);  // Max for player, Min for opponent
+
+    // Best root move and score of the previous iteration, the move is searched first and the score centres the window
+    uint16_t bestRootMove = TranspositionTable::NoMove;
+    double previousScore = NAN;
+
+    // Iterative deepening loop
+    while (!PollCancellation(context, true) && depth <= context.options.max_depth) {
+        // Get all possible moves
+        std::vector<Move> moves = GetPossibleMoves(state, 5.0f, context.options.max_wait);
+        SortMoves(moves, context, 0, state.turn, bestRootMove);  // Sort moves to improve pruning efficiency
+
+        // Helper threads visit the root moves in a different order so they fill the table with different subtrees
+        if (context.id != 0 && moves.size() > 1) {
+            std::rotate(moves.begin(), moves.begin() + context.id % moves.size(), moves.end());
+        }
+
+#ifdef MACRO_DEBUG_OUTPUT
+        // Print the possible moves
+        if (depth == 1 && context.id == 0) {
+            for (const auto& move : moves) {
+                const auto& it = UnitTypeNames.find(move.unit);
+
+                if (it != UnitTypeNames.end()) {
+                    std::cout << "Move: " << it->second << " (" << move.cost.minerals << ", " << move.cost.vespene << ") t=" << move.delta_time << std::endl;
+                }
+                else {
+                    std::cout << "Move: " << static_cast<int32_t>(move.unit) << " (" << move.cost.minerals << ", " << move.cost.vespene << ") t=" << move.delta_time << std::endl;
+                }
+            }
+
+            std::cout << "----------------" << std::endl;
+        }
+#endif
+
+        // Search with current depth, in a window around the previous score if there is one
+        double delta = context.options.aspiration_window;
+        double alpha = -INFINITY;
+        double beta = INFINITY;
+
+        if (delta > 0.0 && std::isfinite(previousScore)) {
+            alpha = previousScore - delta;
+            beta = previousScore + delta;
+        }
+
+        double bestScore = SearchRoot(depth, alpha, beta, state, context, moves);
+
+        // Widen the side of the window the score fell outside of until it lands inside, then give up on the window
+        while (!context.stopped && ((bestScore <= alpha && alpha != -INFINITY) || (bestScore >= beta && beta != INFINITY))) {
+            ++context.statistics.aspiration_researches;
+
+            delta *= 2.0;
+            const bool unbounded = delta > context.options.aspiration_window * 16.0;
+
+            if (bestScore <= alpha) {
+                alpha = unbounded ? -INFINITY : bestScore - delta;
+            } else {
+                beta = unbounded ? INFINITY : bestScore + delta;
+            }
+
+            bestScore = SearchRoot(depth, alpha, beta, state, context, moves);
+        }
+
+        // Only the root line is copied out of the principal variation table
+        MoveSequence currentBestSequence(bestScore, std::vector<Move>(context.pv[0].begin(), context.pv[0].begin() + context.pv_length[0]));
+
+        if (context.pv_length[0] != 0) {
+            bestRootMove = EncodeMove(context.pv[0][0]);
+        }
+
+        previousScore = bestScore;
+
+        // An interrupted iteration has not looked at every root move, it is kept unpublished at depth 0 so that any completed line wins
+        if (context.stopped) {
+            if (result_ptr->moves.empty()) {
+                currentBestSequence.depth = 0;
+                *result_ptr = currentBestSequence;
+            }
+
+            break;
+        }
+
+#ifdef USE_TRANSPOSITION
+        // Transposition cutoffs only store the best move, recover the rest of the line from the table
+        ExtendFromTranspositionTable(state, currentBestSequence, depth + 1, context.options.max_wait);
+#endif
+
+        currentBestSequence.depth = depth;
+        context.statistics.depth = depth;
+
+        // Increase depth for iterative deepening
+        depth++;
+
+        // Update the result with the best sequence found so far
+        *result_ptr = currentBestSequence;
+        PublishResult(*context.snapshot, currentBestSequence, true);
+    }
+}
+
+void Macro::SearchMonteCarlo(
+    const BoardState& root,
+    SearchContext& context,
+    std::shared_ptr<MoveSequence> result_ptr
+) {
+    auto& tree = *m_Tree;
+    const auto& options = context.options;
+
+    // Lines stop short of the ply limit so that the playout always has room for one move
+    const int32_t maxPly = MacroMaxPly - 2;
+
+    std::array<uint32_t, MacroMaxPly> path;
+
+    context.random = 0x9E3779B97F4A7C15ull * (context.id + 1);
 
-#ifdef USE_TRANSPOSITION
-    // Save the result to the transposition table before returning
-    SaveToTranspositionTable(state, bestSequence.score, depth, alpha, beta, bestSequence);
-#endif
+    while (!PollCancellation(context, true)) {
+        BoardState state = root;
+        int32_t length = 0;
+        uint32_t index = MonteCarloTree::Root;
 
-    return bestSequence;
-}
+        tree.AddVirtualLoss(index);
+        path[length++] = index;
 
+        // Selection, follow the best upper confidence bound through the expanded part of the tree
+        while (length < maxPly && tree.GetNode(index).expansion.load(std::memory_order_acquire) == ExpansionState::Expanded) {
+            index = tree.SelectChild(index, state.turn, options.exploration);
+            tree.AddVirtualLoss(index);
+            path[length++] = index;
 
-double Macro::EvaluateState(BoardState& state) {
-    double score = 0.0;
+            MakeMove(state, tree.GetNode(index).move);
+            ++context.statistics.nodes;
+        }
 
-    if (state.terminal) {
-        return state.turn ? -INFINITY : INFINITY;
-    }
-    
-    auto& friendly = state.friendly_units;
-    auto& enemy = state.enemy_units;
+        // Expansion, a leaf that has been reached often enough gets its children and the playout continues into the most promising one
+        const bool expand = index == MonteCarloTree::Root || tree.GetNode(index).visits.load(std::memory_order_relaxed) >= options.expansion_visits;
 
-    score += EvaluatePlayer(friendly, enemy);
-    score -= EvaluatePlayer(enemy, friendly);
+        if (expand && length < maxPly && !state.terminal && !tree.IsFull() && tree.BeginExpansion(index)) {
+            std::vector<Move> moves = GetPossibleMoves(state, 5.0f, options.max_wait);
+            SortMoves(moves, context, length, state.turn, TranspositionTable::NoMove);
 
-    return score;
-}
+            if (tree.Expand(index, moves)) {
+                index = tree.SelectChild(index, state.turn, options.exploration);
+                tree.AddVirtualLoss(index);
+                path[length++] = index;
 
-void Macro::MakeMove(BoardState &state, const Move &move)
-{
-    auto& current = state.turn ? state.friendly_units : state.enemy_units;
-    const auto& current_time = current.time;
-    const auto& next_time = current_time + move.delta_time;
-    current.steps.push_back(move);
-    current.resources = current.resources + move.cost;
+                MakeMove(state, tree.GetNode(index).move);
+                ++context.statistics.nodes;
+            }
+        }
 
-    if (!move.nullmove) {
-        current.units[move.unit] += 1;
-    }
+        // Simulation and backpropagation, every node on the path gets the reward and loses its virtual loss
+        const double reward = Playout(state, length, context);
 
-    current.time = next_time;
-    state.turn = !state.turn;
-}
+        for (int32_t i = 0; i < length; ++i) {
+            tree.Update(path[i], reward);
+        }
 
-void Macro::UnmakeMove(BoardState &state, const Move &move)
-{
-    // First, toggle back the turn since the turn was switched at the end of MakeMove.
-    state.turn = !state.turn;
-    auto& current = state.turn ? state.friendly_units : state.enemy_units;
-    
-    // Reverse the time step by subtracting move.delta_time.
-    const auto& current_time = current.time;
-    const auto& prev_time = current_time - move.delta_time;
-    current.time = prev_time;
+        ++context.statistics.playouts;
 
-    // Remove the last move from the steps deque.
-    if (!current.steps.empty()) {
-        current.steps.pop_back();
+        if (options.max_playouts != 0 && static_cast<uint64_t>(tree.GetNode(MonteCarloTree::Root).visits.load(std::memory_order_relaxed)) >= options.max_playouts) {
+            context.cancellation.request_stop();
+        }
+
+        // Walking the best line is too slow to do every playout, only the main thread checks it for the depth limit
+        if (context.id == 0 && context.statistics.playouts % LineCheckInterval == 0) {
+            const auto line = tree.GetBestSequence(options.line_visits, options.reward_scale);
+            PublishResult(*context.snapshot, line, false);
+
+            if (line.depth >= options.max_depth) {
+                context.cancellation.request_stop();
+            }
+        }
     }
 
-    // Reverse the resource addition by subtracting the move's cost.
-    current.resources = current.resources - move.cost;
+    *result_ptr = tree.GetBestSequence(options.line_visits, options.reward_scale);
 
-    if (!move.nullmove) {
-        current.units[move.unit] -= 1;
+    if (context.id == 0) {
+        PublishResult(*context.snapshot, *result_ptr, false);
     }
+
+    context.statistics.depth = result_ptr->depth;
+    context.statistics.tree_nodes = tree.GetSize();
 }
 
-std::vector<Move> Macro::GetPossibleMoves(BoardState &state, float timestep)
+double Macro::Playout(BoardState& state, int32_t ply, SearchContext& context)
 {
-    std::vector<Move> moves;
+    const int32_t end = std::min(ply + context.options.playout_depth, MacroMaxPly - 1);
 
-    auto& current = state.turn ? state.friendly_units : state.enemy_units;
+    // Uniformly random moves, the state is a copy so the moves are never unmade
+    for (; ply < end && !state.terminal; ++ply) {
+        const auto moves = GetPossibleMoves(state, 5.0f, context.options.max_wait);
 
-    const auto& friendly_units = current.units;
-    const auto& planned_units = current.planned_units;
-    const auto& current_time = current.time;
+        MakeMove(state, moves[NextRandom(context.random) % moves.size()]);
+        ++context.statistics.nodes;
+    }
 
-    // Count all workers and extractors
-    uint32_t num_workers = 0;
-    uint32_t num_extractors = 0;
-    uint32_t num_bases = 0;
-    int32_t num_supply = 0;
-    for (const auto& [type, count] : friendly_units) {
-        switch (type) {
-            case sc2::UNIT_TYPEID::PROTOSS_PROBE:
-            case sc2::UNIT_TYPEID::TERRAN_SCV:
-            case sc2::UNIT_TYPEID::ZERG_DRONE:
-                num_workers += count;
-                break;
-            case sc2::UNIT_TYPEID::PROTOSS_ASSIMILATOR:
-            case sc2::UNIT_TYPEID::TERRAN_REFINERY:
-            case sc2::UNIT_TYPEID::ZERG_EXTRACTOR:
-                num_extractors += count;
-                break;
-            case sc2::UNIT_TYPEID::PROTOSS_NEXUS:
-            case sc2::UNIT_TYPEID::TERRAN_COMMANDCENTER:
-            case sc2::UNIT_TYPEID::ZERG_HATCHERY:
-            case sc2::UNIT_TYPEID::ZERG_HIVE:
-            case sc2::UNIT_TYPEID::ZERG_LAIR:
-                num_bases += count;
-                num_supply += count * 15;
-                break;
-            case sc2::UNIT_TYPEID::PROTOSS_PYLON:
-            case sc2::UNIT_TYPEID::TERRAN_SUPPLYDEPOT:
-            case sc2::UNIT_TYPEID::ZERG_OVERLORD:
-                num_supply += count * 8;
-                break;
-        }
+    // Squash the evaluation into the reward of the friendly player
+    return 1.0 / (1.0 + std::exp(-EvaluateState(state) / context.options.reward_scale));
+}
 
-        const auto& ability_it = UnitToAbility.find(type);
+void Macro::SearchBeam(
+    const BoardState& root,
+    SearchContext& context,
+    std::shared_ptr<MoveSequence> result_ptr
+) {
+    auto& beam = *m_Beam;
+    auto& candidates = beam.candidates[context.id];
+    const size_t workers = beam.candidates.size();
 
-        if (ability_it != UnitToAbility.end()) {
-            const auto& ability = ability_it->second;
+    while (true) {
+        candidates.clear();
 
-            const auto& supply_it = UnitSupply.find(ability);
+        // Expansion, the workers take every n-th state of the beam. Children are scored and dropped again,
+        // only the few that are selected are rebuilt.
+        for (size_t i = context.id; i < beam.states.size() && !PollCancellation(context, true); i += workers) {
+            BoardState state = beam.states[i];
 
-            if (supply_it != UnitSupply.end()) {
-                const auto& supply = supply_it->second;
+            for (const auto& move : GetPossibleMoves(state, 5.0f, context.options.max_wait)) {
+                BoardState child = state;
+                MakeBeamSlice(child, move);
+                ++context.statistics.nodes;
 
-                num_supply -= count * supply;
+                candidates.push_back({child.hash, EvaluateState(child), static_cast<uint32_t>(i), move});
             }
         }
-    }
-
-    int32_t vespene_workers = std::min(num_extractors * 3, num_workers);
-    int32_t mineral_workers = std::min(num_bases * 12, num_workers - vespene_workers);
-    int32_t excess_workers = num_workers - vespene_workers - mineral_workers;
 
-    int32_t vespene_income = std::ceilf(vespene_workers * 0.94f * timestep);
-    int32_t mineral_income = std::ceilf(mineral_workers * 1.256f * timestep);
+        beam.barrier.arrive_and_wait();
 
-    ResourcePair resources = {mineral_income, vespene_income};
-
-    // Generate all possible moves
-    for (const auto& [ability, requirements] : AbilityRequirements) {
-        if (ability == sc2::ABILITY_ID::TRAIN_PROBE) {
-            if (num_workers >= (num_bases * 12 + num_extractors * 3)) {
-                continue;
-            }
+        if (context.id == 0) {
+            SelectBeam(root, context, result_ptr);
         }
 
-        if (ability == sc2::ABILITY_ID::BUILD_ASSIMILATOR) {
-            if (num_extractors >= num_bases * 2) {
-                continue;
-            }
-        }
+        beam.barrier.arrive_and_wait();
 
-        // If we have more than 8 free supply, don't build pylons
-        if (ability == sc2::ABILITY_ID::BUILD_PYLON) {
-            if (num_supply >= 8) {
-                continue;
-            }
+        if (beam.finished) {
+            break;
         }
+    }
+}
 
-        // Check if we have enough resources
-        const auto& cost = AbilityCosts[ability];
-        if (current.resources.minerals < cost.minerals || current.resources.vespene < cost.vespene) {
-            continue;
-        }
+void Macro::SelectBeam(const BoardState& root, SearchContext& context, std::shared_ptr<MoveSequence> result_ptr)
+{
+    auto& beam = *m_Beam;
+    const auto& options = context.options;
+
+    // A cancelled expansion is incomplete, keep the plan of the last full time slice. Another worker may have
+    // seen the request during the expansion, the barrier makes it visible here.
+    if (PollCancellation(context, true)) {
+        beam.finished = true;
+        return;
+    }
 
-        // Check if we have the required units
-        bool valid = true;
-        for (const auto& type : requirements) {
-            const auto& it = friendly_units.find(type);
-            if (it == friendly_units.end() || it->second == 0) {
-                valid = false;
-                break;
-            }
-        }
-        if (!valid) {
-            continue;
-        }
+    // The plan is made for the side to move at the root
+    const double sign = root.turn ? 1.0 : -1.0;
 
-        const auto& supply_it = UnitSupply.find(ability);
-        if (supply_it != UnitSupply.end()) {
-            const auto& supply = supply_it->second;
+    std::vector<BeamCandidate> merged;
+    for (const auto& candidates : beam.candidates) {
+        merged.insert(merged.end(), candidates.begin(), candidates.end());
+    }
 
-            int32_t available_supply = num_supply - supply;
+    // Children that transpose into the same state only take one place in the beam, the best one is kept
+    std::sort(merged.begin(), merged.end(), [sign](const BeamCandidate& a, const BeamCandidate& b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.score * sign > b.score * sign;
+    });
 
-            if (available_supply < 0) {
-                continue;
-            }
-        }
+    const auto unique_end = std::unique(merged.begin(), merged.end(), [](const BeamCandidate& a, const BeamCandidate& b) {
+        return a.hash == b.hash;
+    });
 
-        const auto& ability_unit_it = AbilityToUnit.find(ability);
+    context.statistics.beam_duplicates += std::distance(unique_end, merged.end());
+    merged.erase(unique_end, merged.end());
 
-        if (ability_unit_it == AbilityToUnit.end()) {
-            continue;
-        }
+    // Cannot happen while passing is always possible, but an empty beam would have nothing to expand
+    if (merged.empty()) {
+        beam.finished = true;
+        return;
+    }
 
-        const auto& ability_unit = ability_unit_it->second;
+    const size_t keep = std::min(std::max<size_t>(options.beam_width, 1), merged.size());
 
-        // Get the production time for the unit
-        float production_time = 0.0f;
-        const auto& unit_data = this->m_UnitTypes.at(sc2::UnitTypeID(ability_unit));
-        production_time = Utilities::ToSecondsFromGameTime(unit_data.build_time);
+    std::partial_sort(merged.begin(), merged.begin() + keep, merged.end(), [sign](const BeamCandidate& a, const BeamCandidate& b) {
+        return a.score * sign > b.score * sign;
+    });
 
-        moves.push_back({false, ability_unit, resources - cost, current_time + production_time, 5.0f});
-    }
+    std::vector<BoardState> states(keep);
+    std::vector<BeamStep> steps;
+    steps.reserve(keep);
 
-    // Can always pass
-    moves.push_back({true, sc2::UNIT_TYPEID::INVALID, resources, 0.0f, 5.0f});
+    for (size_t i = 0; i < keep; ++i) {
+        const auto& candidate = merged[i];
 
-    return moves;
-}
+        states[i] = beam.states[candidate.parent];
+        const Move reply = MakeBeamSlice(states[i], candidate.move);
 
-// Modified GetBestMove function with time control and iterative deepening
-void Macro::GetBestMove(
-    BoardState& state, 
-    std::shared_ptr<bool> cancellation_token,
-    std::shared_ptr<MoveSequence> result_ptr
-) {
-    // Start with a shallow depth and increase iteratively
-    int32_t depth = 1;
-    *result_ptr = MoveSequence(state.turn ? -INFINITY : INFINITY);  // Max for player, Min for opponent
+        steps.push_back({candidate.parent, candidate.move, reply});
+    }
 
-    // Iterative deepening loop
-    while (!*cancellation_token) {
-        MoveSequence currentBestSequence(state.turn ? -INFINITY : INFINITY);  // Store current best move sequence
+    beam.states.swap(states);
+    beam.steps.push_back(std::move(steps));
 
-        // Get all possible moves
-        std::vector<Move> moves = GetPossibleMoves(state, 5.0f);
-        SortMoves(moves);  // Sort moves using a heuristic to improve pruning efficiency
+    // Walk back from the best state of the slice to the root
+    MoveSequence sequence(merged[0].score);
 
-        // Print the possible moves
-        if (depth == 1) {
-            for (const auto& move : moves) {
-                const auto& it = UnitTypeNames.find(move.unit);
+    uint32_t index = 0;
+    for (auto slice = beam.steps.rbegin(); slice != beam.steps.rend(); ++slice) {
+        const auto& step = (*slice)[index];
+        sequence.moves.push_back(step.reply);
+        sequence.moves.push_back(step.move);
+        index = step.parent;
+    }
 
-                if (it != UnitTypeNames.end()) {
-                    std::cout << "Move: " << it->second << " (" << move.cost.minerals << ", " << move.cost.vespene << ") t=" << move.delta_time << std::endl;
-                }
-                else {
-                    std::cout << "Move: " << static_cast<int32_t>(move.unit) << " (" << move.cost.minerals << ", " << move.cost.vespene << ") t=" << move.delta_time << std::endl;
-                }
-            }
+    std::reverse(sequence.moves.begin(), sequence.moves.end());
 
-            std::cout << "----------------" << std::endl;
-        }
+    sequence.depth = static_cast<int32_t>(beam.steps.size());
+    context.statistics.depth = sequence.depth;
 
-        // Search with current depth
-        for (const Move& move : moves) {
-            auto oldState = state;
-            
-            MakeMove(state, move);
+    *result_ptr = sequence;
+    PublishResult(*context.snapshot, sequence, true);
 
-            // Search for the best move sequence with time control
-            MoveSequence result = SearchBuild(depth, -INFINITY, INFINITY, state, cancellation_token);
+    const auto& planner = root.turn ? beam.states[0].friendly_units : beam.states[0].enemy_units;
+    const auto& start = root.turn ? root.friendly_units : root.enemy_units;
 
-            UnmakeMove(state, move);
-            //state = oldState;
+    beam.finished = sequence.depth >= options.max_depth || planner.time - start.time >= options.horizon;
+}
 
-            // Add the current move to the result sequence
-            result.moves.insert(result.moves.begin(), move);
+Move Macro::MakeBeamSlice(BoardState& state, const Move& move)
+{
+    // The other player passes, so every state of a time slice is compared against the same opponent
+    MakeMove(state, move);
 
-            // Update best sequence based on the current player's turn
-            if (state.turn) {  // Maximizing player
-                if (result.score > currentBestSequence.score) {
-                    currentBestSequence = result;
-                }
-            } else {  // Minimizing player
-                if (result.score < currentBestSequence.score) {
-                    currentBestSequence = result;
-                }
-            }
-        }
+    const Move reply = GetPassMove(state, 5.0f);
+    MakeMove(state, reply);
 
-        // Increase depth for iterative deepening
-        depth++;
+    // Beam states are never unmade, the completion logs would otherwise overflow over a long horizon
+    state.friendly_units.completed_count = 0;
+    state.enemy_units.completed_count = 0;
 
-        // Update the result with the best sequence found so far
-        *result_ptr = currentBestSequence;
-    }
+    return reply;
 }
 
 double Macro::MoveHeuristic(const Move &move)
@@ -422,11 +1549,44 @@ double Macro::MoveHeuristic(const Move &move)
     return heuristic;
 }
 
-void Macro::SortMoves(std::vector<Move>& moves)
+void Macro::SortMoves(std::vector<Move>& moves, const SearchContext& context, int32_t ply, bool friendly, uint16_t tt_move)
 {
-    std::sort(moves.begin(), moves.end(), [this](const Move& a, const Move& b) {
-        return MoveHeuristic(a) > MoveHeuristic(b);
-    });
+    const auto count = std::min(moves.size(), MacroMaxOrderedMoves);
+    const auto& killers = context.killers[ply];
+    const auto& history = context.history[friendly];
+
+    // Score every move once, the sort only compares the cached scores
+    std::array<double, MacroMaxOrderedMoves> scores;
+    for (size_t i = 0; i < count; ++i) {
+        const auto& move = moves[i];
+        const auto encoded = EncodeMove(move);
+
+        if (encoded == tt_move) {
+            scores[i] = TTMoveScore;
+        } else if (encoded == killers[0]) {
+            scores[i] = KillerScore;
+        } else if (encoded == killers[1]) {
+            scores[i] = KillerScore - 1;
+        } else {
+            const auto index = HistoryIndex(move);
+            scores[i] = history[index] + m_MoveHeuristics[index];
+        }
+    }
+
+    // Insertion sort, the lists are short and moves with equal scores keep their generation order
+    for (size_t i = 1; i < count; ++i) {
+        const auto move = moves[i];
+        const auto score = scores[i];
+
+        size_t j = i;
+        for (; j > 0 && scores[j - 1] < score; --j) {
+            moves[j] = moves[j - 1];
+            scores[j] = scores[j - 1];
+        }
+
+        moves[j] = move;
+        scores[j] = score;
+    }
 }
 
 double Macro::EvaluatePlayer(PlayerState &a, PlayerState &b)
@@ -437,67 +1597,12 @@ double Macro::EvaluatePlayer(PlayerState &a, PlayerState &b)
     //score -= a.resources.minerals * 0.5;
     //score -= a.resources.vespene * 0.75;
 
-    int32_t base_count = 0;
-    int32_t worker_count = 0;
-    int32_t assimilator_count = 0;
-    int32_t supply_count = 0;
-
-    for (const auto& [type, count] : a.units) {
-        switch (type) {
-            case sc2::UNIT_TYPEID::PROTOSS_NEXUS:
-            case sc2::UNIT_TYPEID::TERRAN_COMMANDCENTER:
-            case sc2::UNIT_TYPEID::ZERG_HATCHERY:
-            case sc2::UNIT_TYPEID::ZERG_HIVE:
-            case sc2::UNIT_TYPEID::ZERG_LAIR:
-                base_count += count;
-                supply_count += count * 15;
-                break;
-            case sc2::UNIT_TYPEID::PROTOSS_PROBE:
-            case sc2::UNIT_TYPEID::TERRAN_SCV:
-            case sc2::UNIT_TYPEID::ZERG_DRONE:
-                worker_count += count;
-                break;
-            case sc2::UNIT_TYPEID::PROTOSS_ASSIMILATOR:
-            case sc2::UNIT_TYPEID::TERRAN_REFINERY:
-            case sc2::UNIT_TYPEID::ZERG_EXTRACTOR:
-                assimilator_count += count;
-                break;
-            case sc2::UNIT_TYPEID::PROTOSS_PYLON:
-            case sc2::UNIT_TYPEID::TERRAN_SUPPLYDEPOT:
-            case sc2::UNIT_TYPEID::ZERG_OVERLORD:
-                supply_count += count * 8;
-                break;
-        }
-        
-        const auto& ability_it = UnitToAbility.find(type);
-
-        if (ability_it != UnitToAbility.end()) {
-            const auto& ability = ability_it->second;
-
-            const auto& supply_it = UnitSupply.find(ability);
-
-            if (supply_it != UnitSupply.end()) {
-                const auto& supply = supply_it->second;
-
-                score += count * supply * (ability == sc2::ABILITY_ID::TRAIN_PROBE ? 50 : 400);
-
-                supply_count -= count * supply;
-            }
-
-            const auto& ability_cost_it = AbilityCosts.find(ability);
-
-            if (ability_cost_it != AbilityCosts.end()) {
-                const auto& cost = ability_cost_it->second;
+    const int32_t base_count = a.bases + a.planned_bases;
+    const int32_t worker_count = a.workers + a.planned_workers;
+    const int32_t assimilator_count = a.extractors + a.planned_extractors;
 
-                if (ability == sc2::ABILITY_ID::BUILD_PYLON || ability == sc2::ABILITY_ID::TRAIN_OVERLORD || ability == sc2::ABILITY_ID::BUILD_SUPPLYDEPOT) {
-                    
-                }
-                else {
-                    score += count * (cost.minerals + cost.vespene * 1.5);
-                }
-            }
-        }
-    }
+    // Value of the units, kept up to date by MakeMove/UnmakeMove
+    score += a.material + a.planned_material;
 
     score += base_count * 100;
 
@@ -514,7 +1619,7 @@ double Macro::EvaluatePlayer(PlayerState &a, PlayerState &b)
     }
     
     // If we are close to supply cap, penalize, exponentially
-    //const auto supply_delta = std::abs(supply_count);
+    //const auto supply_delta = std::abs(a.supply);
 
     //score -= supply_delta * 1000;
 
@@ -528,40 +1633,65 @@ bool Macro::CompareStates(BoardState& a, BoardState& b)
 
 BoardState Macro::GetState()
 {
-    BoardState state;
+    BoardState state {};
     const auto* obs = m_Collective->Observation();
 
     state.friendly_units.resources.minerals = obs->GetMinerals();
     state.friendly_units.resources.vespene = obs->GetVespene();
 
+    // Units the search does not model are left out
     for (const auto& unit : obs->GetUnits()) {
+        const auto index = GetMacroUnitIndex(unit->unit_type);
+
+        if (index == InvalidMacroUnit) {
+            continue;
+        }
+
         if (unit->alliance == sc2::Unit::Alliance::Self) {
-            state.friendly_units.units[unit->unit_type] += 1;
+            auto& friendly = state.friendly_units;
+
+            // The timeline model completes units that are still in production once their build time has passed
+            const auto& unit_data = m_UnitTypes.at(sc2::UnitTypeID(unit->unit_type));
+            const auto remaining = (1.0f - unit->build_progress) * Utilities::ToSecondsFromGameTime(unit_data.build_time);
+
+            if (MACRO_TIMELINE_MODEL && remaining > 0.0f && friendly.pending_count < MacroMaxPending / 2) {
+                friendly.pending[friendly.pending_count++] = {remaining, index};
+                friendly.planned_units[index] += 1;
+                continue;
+            }
+
+            friendly.units[index] += 1;
         } else if (unit->alliance == sc2::Unit::Alliance::Enemy) {
-            state.enemy_units.units[unit->unit_type] += 1;
+            state.enemy_units.units[index] += 1;
         }
     }
 
+#ifdef MACRO_DEBUG_OUTPUT
     // Print the state
     std::cout << "Friendly units:" << std::endl;
-    for (const auto& [type, count] : state.friendly_units.units) {
-        std::cout << UnitTypeNames[type] << ": " << count << std::endl;
+    for (size_t i = 0; i < MacroUnitCount; ++i) {
+        if (state.friendly_units.units[i] != 0) {
+            std::cout << UnitTypeNames[MacroUnitTypes[i]] << ": " << state.friendly_units.units[i] << std::endl;
+        }
     }
 
     std::cout << "Enemy units:" << std::endl;
-    for (const auto& [type, count] : state.enemy_units.units) {
-        std::cout << UnitTypeNames[type] << ": " << count << std::endl;
+    for (size_t i = 0; i < MacroUnitCount; ++i) {
+        if (state.enemy_units.units[i] != 0) {
+            std::cout << UnitTypeNames[MacroUnitTypes[i]] << ": " << state.enemy_units.units[i] << std::endl;
+        }
     }
+#endif
 
     // TODO: Update based on scounted info
-    state.enemy_units.units[sc2::UNIT_TYPEID::PROTOSS_NEXUS] = 1;
-    state.enemy_units.units[sc2::UNIT_TYPEID::PROTOSS_PROBE] = 12;
+    state.enemy_units.units[GetMacroUnitIndex(sc2::UNIT_TYPEID::PROTOSS_NEXUS)] = 1;
+    state.enemy_units.units[GetMacroUnitIndex(sc2::UNIT_TYPEID::PROTOSS_PROBE)] = 12;
     state.enemy_units.resources.minerals = 50;
     state.enemy_units.resources.vespene = 0;
 
     state.terminal = false;
     state.turn = true;
-    state.simple = true;
+    state.simple = !MACRO_TIMELINE_MODEL;
 
     state.friendly_units.time = 0;
     state.enemy_units.time = 0;
@@ -569,59 +1699,193 @@ BoardState Macro::GetState()
     return state;
 }
 
+// Derive everything that MakeMove/UnmakeMove keep up to date incrementally
+void Macro::PrepareState(BoardState& state) {
+    for (const bool friendly : {true, false}) {
+        auto* player = friendly ? &state.friendly_units : &state.enemy_units;
+
+        const auto begin = player->pending.begin();
+        std::make_heap(begin, begin + player->pending_count, CompletesLater);
+
+        // Units already due would complete in the first move and could not be rewound past the root, complete them now
+        player->completed_count = 0;
+        AdvanceTimeline(state, friendly, player->time);
+        player->completed_count = 0;
+
+        ComputeAggregates(*player);
+    }
+
+    state.hash = ComputeHash(state);
+}
+
+// Full hash of a position, only needed for new roots. MakeMove/UnmakeMove keep state.hash up to date.
 uint64_t Macro::ComputeHash(const BoardState& state) {
     uint64_t hash = 0;
-    for (const auto& [type, count] : state.friendly_units.units) {
-        hash ^= static_cast<int32_t>(type) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
-        hash ^= count + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    for (size_t i = 0; i < MacroUnitCount; ++i) {
+        hash ^= Zobrist::UnitKey(true, MacroUnitTypes[i], state.friendly_units.units[i]);
+        hash ^= Zobrist::UnitKey(false, MacroUnitTypes[i], state.enemy_units.units[i]);
+        hash ^= Zobrist::PlannedKey(true, MacroUnitTypes[i], state.friendly_units.planned_units[i]);
+        hash ^= Zobrist::PlannedKey(false, MacroUnitTypes[i], state.enemy_units.planned_units[i]);
     }
-    for (const auto& [type, count] : state.enemy_units.units) {
-        hash ^= static_cast<int32_t>(type) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
-        hash ^= count + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= Zobrist::ResourceKey(true, state.friendly_units.resources) ^ Zobrist::TimeKey(true, state.friendly_units.time);
+    hash ^= Zobrist::ResourceKey(false, state.enemy_units.resources) ^ Zobrist::TimeKey(false, state.enemy_units.time);
+    if (state.turn) {
+        hash ^= Zobrist::TurnKey();
     }
     return hash;
 }
 
 // Transposition table lookup
-bool Macro::LookupTranspositionTable(const BoardState& state, int32_t depth, double alpha, double beta, MoveSequence& outResult) {
-    uint64_t hash = ComputeHash(state); // A function that computes a unique hash for each position
-    if (m_TranspositionTable.find(hash) != m_TranspositionTable.end()) {
-        const TranspositionEntry& entry = m_TranspositionTable[hash];
-        if (entry.depth >= depth) {  // Check if this depth is as deep or deeper than the current search
-            if (entry.score <= alpha) {
-                outResult.score = entry.score;
-                outResult.moves = entry.bestMoveSequence;
-                return true; // Alpha cutoff
-            }
-            if (entry.score >= beta) {
-                outResult.score = entry.score;
-                outResult.moves = entry.bestMoveSequence;
-                return true; // Beta cutoff
-            }
-        }
+bool Macro::LookupTranspositionTable(const BoardState& state, int32_t depth, double alpha, double beta, double& outScore, uint16_t& outMove, SearchStatistics& statistics) {
+    TranspositionEntry entry;
+    ++statistics.tt_probes;
+    if (!m_TranspositionTable.Probe(state.hash, entry)) {
+        return false;
+    }
+    ++statistics.tt_hits;
+    outMove = entry.move;  // The best move is useful for ordering even if the entry is too shallow
+    if (entry.depth < depth) {  // Only use results that are as deep or deeper than the current search
+        return false;
+    }
+    if (entry.bound == Bound::Exact ||
+        (entry.bound == Bound::Upper && entry.score <= alpha) ||  // Alpha cutoff
+        (entry.bound == Bound::Lower && entry.score >= beta)) {   // Beta cutoff
+        outScore = entry.score;
+        ++statistics.tt_cutoffs;
+        return true;
     }
     return false;
 }
 
 // Save to the transposition table
-void Macro::SaveToTranspositionTable(const BoardState& state, double score, int32_t depth, double alpha, double beta, const MoveSequence& bestSequence) {
-    uint64_t hash = ComputeHash(state);
-    m_TranspositionTable[hash] = { score, depth, alpha, beta, bestSequence.moves };
+void Macro::SaveToTranspositionTable(const BoardState& state, double score, int32_t depth, double alpha, double beta, uint16_t move) {
+    Bound bound = Bound::Exact;
+    if (score <= alpha) {
+        bound = Bound::Upper;
+    } else if (score >= beta) {
+        bound = Bound::Lower;
+    }
+    m_TranspositionTable.Store(state.hash, score, depth, bound, move);
+}
+
+// Follow the opening book from a position, as far as it has the positions the moves lead to
+bool Macro::ProbeOpeningBook(BoardState state, MoveSequence& sequence)
+{
+    OpeningBookEntry entry;
+    if (m_OpeningBook == nullptr || !m_OpeningBook->Lookup(state.hash, entry)) {
+        return false;
+    }
+
+    sequence = MoveSequence();
+    sequence.depth = entry.depth;
+
+    // Follow the book for as long as it has the positions the moves lead to
+    do {
+        const auto moves = GetPossibleMoves(state, 5.0f, m_SearchOptions.max_wait);
+        const auto it = std::find_if(moves.begin(), moves.end(), [&entry](const Move& move) {
+            return EncodeMove(move) == entry.move;
+        });
+
+        // Written with other move options, the book no longer applies
+        if (it == moves.end()) {
+            break;
+        }
+
+        MakeMove(state, *it);
+        sequence.moves.push_back(*it);
+    } while (sequence.moves.size() < MacroMaxPly - 1 && m_OpeningBook->Lookup(state.hash, entry));
+
+    // The book only has moves, the line is scored by the position it leads to
+    sequence.score = EvaluateState(state);
+
+    return !sequence.moves.empty();
+}
+
+// Follow the best moves stored in the transposition table until the sequence has the given length
+void Macro::ExtendFromTranspositionTable(BoardState state, MoveSequence& sequence, int32_t length, float max_wait) {
+    for (const auto& move : sequence.moves) {
+        MakeMove(state, move);
+    }
+
+    while (static_cast<int32_t>(sequence.moves.size()) < length) {
+        TranspositionEntry entry;
+        if (!m_TranspositionTable.Probe(state.hash, entry) || entry.move == TranspositionTable::NoMove) {
+            break;
+        }
+
+        const auto moves = GetPossibleMoves(state, 5.0f, max_wait);
+        const auto it = std::find_if(moves.begin(), moves.end(), [&entry](const Move& move) {
+            return EncodeMove(move) == entry.move;
+        });
+
+        if (it == moves.end()) {
+            break;
+        }
+
+        MakeMove(state, *it);
+        sequence.moves.push_back(*it);
+    }
+}
+
+uint16_t Macro::EncodeMove(const Move& move) {
+    // Pass moves have an invalid unit type, which encodes as 0. Unit type ids fit in 15 bits, the top bit marks a wait.
+    if (move.nullmove) {
+        return 0;
+    }
+
+    return static_cast<uint16_t>(move.unit) | (move.wait_time > 0.0f ? WaitMoveBit : 0);
 }
 
 std::shared_ptr<MoveSequence> MacroPromise::Complete()
 {
-    if (m_CancellationToken) {
-        *m_CancellationToken = true;
-        m_Thread.join();
+    m_Cancellation.request_stop();
+
+    Wait();
+
+    // Take the deepest result, the main thread wins ties unless it has no line at all
+    std::shared_ptr<MoveSequence> best;
+    for (const auto& result : m_Results) {
+        if (best == nullptr || result->depth > best->depth ||
+            (result->depth == best->depth && best->moves.empty() && !result->moves.empty())) {
+            best = result;
+        }
+    }
+
+    return best != nullptr ? best : std::make_shared<MoveSequence>();
+}
+
+void MacroPromise::Wait()
+{
+    // The workers stay alive, wait until they have left this root. A newer root means they already did.
+    if (m_Control) {
+        std::unique_lock lock(m_Control->mutex);
+        m_Control->condition.wait(lock, [this]() {
+            return m_Control->generation != m_Generation || m_Control->running == 0;
+        });
+    }
+}
+
+std::shared_ptr<const MoveSequence> MacroPromise::Peek() const
+{
+    if (m_Snapshot == nullptr) {
+        return nullptr;
     }
 
-    return m_Result;
+    return std::atomic_load_explicit(&m_Snapshot->sequence, std::memory_order_acquire);
 }
 
-scbot::MacroPromise::~MacroPromise()
+SearchStatistics MacroPromise::GetStatistics() const
 {
-    if (m_CancellationToken) {
-        *m_CancellationToken = true;
+    SearchStatistics total;
+    for (const auto& statistics : m_Statistics) {
+        total.Add(*statistics);
     }
+
+    return total;
+}
+
+scbot::MacroPromise::~MacroPromise()
+{
+    // Stop the workers, but do not wait for them, the next search does that
+    m_Cancellation.request_stop();
 }
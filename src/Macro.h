@@ -1,59 +1,186 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <condition_variable>
+#include <mutex>
+#include <stop_token>
 #include <thread>
+#include <type_traits>
 
 #include "Collective.h"
+#include "OpeningBook.h"
+#include "TranspositionTable.h"
 
 #include <sc2api/sc2_interfaces.h>
 
 namespace scbot {
 
+class MonteCarloTree;
+
+// Unit types tracked by the macro search, the per-player counters are indexed in this order.
+constexpr std::array<sc2::UNIT_TYPEID, 33> MacroUnitTypes = {
+    sc2::UNIT_TYPEID::PROTOSS_PROBE,
+    sc2::UNIT_TYPEID::PROTOSS_NEXUS,
+    sc2::UNIT_TYPEID::PROTOSS_PYLON,
+    sc2::UNIT_TYPEID::PROTOSS_ASSIMILATOR,
+    sc2::UNIT_TYPEID::PROTOSS_GATEWAY,
+    sc2::UNIT_TYPEID::PROTOSS_FORGE,
+    sc2::UNIT_TYPEID::PROTOSS_CYBERNETICSCORE,
+    sc2::UNIT_TYPEID::PROTOSS_ROBOTICSFACILITY,
+    sc2::UNIT_TYPEID::PROTOSS_STARGATE,
+    sc2::UNIT_TYPEID::PROTOSS_TWILIGHTCOUNCIL,
+    sc2::UNIT_TYPEID::PROTOSS_TEMPLARARCHIVE,
+    sc2::UNIT_TYPEID::PROTOSS_DARKSHRINE,
+    sc2::UNIT_TYPEID::PROTOSS_FLEETBEACON,
+    sc2::UNIT_TYPEID::PROTOSS_ROBOTICSBAY,
+    sc2::UNIT_TYPEID::PROTOSS_PHOTONCANNON,
+    sc2::UNIT_TYPEID::PROTOSS_SHIELDBATTERY,
+    sc2::UNIT_TYPEID::PROTOSS_ZEALOT,
+    sc2::UNIT_TYPEID::PROTOSS_STALKER,
+    sc2::UNIT_TYPEID::PROTOSS_SENTRY,
+    sc2::UNIT_TYPEID::PROTOSS_ADEPT,
+    sc2::UNIT_TYPEID::PROTOSS_HIGHTEMPLAR,
+    sc2::UNIT_TYPEID::PROTOSS_DARKTEMPLAR,
+    sc2::UNIT_TYPEID::PROTOSS_OBSERVER,
+    sc2::UNIT_TYPEID::PROTOSS_WARPPRISM,
+    sc2::UNIT_TYPEID::PROTOSS_IMMORTAL,
+    sc2::UNIT_TYPEID::PROTOSS_COLOSSUS,
+    sc2::UNIT_TYPEID::PROTOSS_DISRUPTOR,
+    sc2::UNIT_TYPEID::PROTOSS_PHOENIX,
+    sc2::UNIT_TYPEID::PROTOSS_ORACLE,
+    sc2::UNIT_TYPEID::PROTOSS_VOIDRAY,
+    sc2::UNIT_TYPEID::PROTOSS_CARRIER,
+    sc2::UNIT_TYPEID::PROTOSS_TEMPEST,
+    sc2::UNIT_TYPEID::PROTOSS_MOTHERSHIP
+};
+
+constexpr size_t MacroUnitCount = MacroUnitTypes.size();
+
+static_assert(MacroUnitCount <= 64, "Owned unit types are tracked in a 64-bit mask");
+
+// Index of unit types that are not tracked by the macro search
+constexpr uint8_t InvalidMacroUnit = 0xFF;
+
+/**
+ * @brief Get the index of a unit type in MacroUnitTypes.
+ * 
+ * @param type The unit type
+ * @return The index, or InvalidMacroUnit if the type is not tracked
+ */
+uint8_t GetMacroUnitIndex(sc2::UNIT_TYPEID type);
+
+/**
+ * @brief What a single unit of a tracked type adds to the aggregates of a PlayerState.
+ */
+struct MacroUnitTraits {
+    int32_t workers;
+    int32_t extractors;
+    int32_t bases;
+    // Supply provided minus supply used
+    int32_t supply;
+    // Supply used, a unit in production uses supply before it provides any
+    int32_t supply_cost;
+    // Contribution to the evaluation
+    double material;
+};
+
+/**
+ * @brief Get the aggregate contribution of a tracked unit type.
+ * 
+ * @param index The index of the unit type in MacroUnitTypes
+ * @return The traits of the unit type
+ */
+const MacroUnitTraits& GetMacroUnitTraits(uint8_t index);
+
 struct Move {
     bool nullmove;
     sc2::UNIT_TYPEID unit;
+    // Index of unit in MacroUnitTypes
+    uint8_t index;
     scdata::ResourcePair cost;
     float complete_time;
     float delta_time;
+    // Seconds to wait before the unit can be afforded, included in delta_time. 0 for units that are started at once.
+    float wait_time;
+    // Time of the player when the move is made, restored as is by UnmakeMove since subtracting delta_time is not exact
+    float start_time;
 
     static bool equals(const Move& lhs, const Move& rhs) {
         return lhs.nullmove == rhs.nullmove &&
             lhs.unit == rhs.unit &&
             lhs.cost == rhs.cost &&
             lhs.complete_time == rhs.complete_time &&
-            lhs.delta_time == rhs.delta_time;
+            lhs.delta_time == rhs.delta_time &&
+            lhs.wait_time == rhs.wait_time &&
+            lhs.start_time == rhs.start_time;
     }
 };
 
+// Maximum number of plies in a single search line, including the root move
+constexpr int32_t MacroMaxPly = 64;
+
+// Maximum number of moves that are ordered in a single position, the rest keep their generation order
+constexpr size_t MacroMaxOrderedMoves = 128;
+
+// Maximum number of units a player can have in production, half is reserved for units planned by the search. Kept
+// small since every child in the beam and Monte Carlo searches copies the whole state.
+constexpr size_t MacroMaxPending = 16;
+
+// Maximum number of units a player can have completed during a search line, bounds the pending and completed units
+// together so that the completion log can never overflow
+constexpr size_t MacroMaxCompleted = 32;
+
+/**
+ * @brief A unit in production in the timeline model.
+ */
+struct PendingUnit {
+    float complete_time;
+    uint8_t index;
+};
+
+/**
+ * @brief Economy and units of one player in the macro search.
+ * 
+ * Counters are indexed by MacroUnitTypes so that the state is trivially copyable and fits in a few cache lines.
+ */
 struct PlayerState {
-    std::unordered_map<sc2::UNIT_TYPEID, uint32_t> units;
-    std::unordered_map<sc2::UNIT_TYPEID, float> planned_units;
-    std::deque<Move> steps;
+    std::array<uint16_t, MacroUnitCount> units;
+    std::array<uint16_t, MacroUnitCount> planned_units;
+    // Bit i is set when units[i] is not 0
+    uint64_t owned;
+    // Aggregates over units, see MacroUnitTraits
+    int32_t workers;
+    int32_t extractors;
+    int32_t bases;
+    int32_t supply;
+    double material;
+    // Aggregates over planned_units, supply only counts the supply the planned units use
+    int32_t planned_workers;
+    int32_t planned_extractors;
+    int32_t planned_bases;
+    int32_t planned_supply;
+    double planned_material;
+    // Units in production, a min-heap on complete_time, only used by the timeline model
+    std::array<PendingUnit, MacroMaxPending> pending;
+    uint8_t pending_count;
+    // Units that completed during the search in order of completion, so that UnmakeMove can reverse them
+    std::array<PendingUnit, MacroMaxCompleted> completed;
+    uint8_t completed_count;
     scdata::ResourcePair resources;
     float time;
+
+    uint16_t Count(sc2::UNIT_TYPEID type) const {
+        const auto index = GetMacroUnitIndex(type);
+        return index == InvalidMacroUnit ? 0 : units[index];
+    }
     
     static bool equals(const PlayerState& lhs, const PlayerState& rhs) {
-        // Compare units and planned_units (unordered_map) and deque steps
-        if (lhs.units.size() != rhs.units.size()) return false;
-        if (lhs.planned_units.size() != rhs.planned_units.size()) return false;
-        if (lhs.steps.size() != rhs.steps.size()) return false;
-
-        // Compare each unit in the unordered_map
-        for (const auto& [key, value] : lhs.units) {
-            if (rhs.units.find(key) == rhs.units.end() || rhs.units.at(key) != value) return false;
-        }
-
-        // Compare each planned unit in the unordered_map
-        for (const auto& [key, value] : lhs.planned_units) {
-            if (rhs.planned_units.find(key) == rhs.planned_units.end() || rhs.planned_units.at(key) != value) return false;
-        }
-
-        // Compare each Move step in the deque
-        for (size_t i = 0; i < lhs.steps.size(); ++i) {
-            if (!Move::equals(lhs.steps[i], rhs.steps[i])) return false;
-        }
-
-        // Compare resources and time
-        return lhs.resources == rhs.resources && lhs.time == rhs.time;
+        return lhs.units == rhs.units &&
+            lhs.planned_units == rhs.planned_units &&
+            lhs.resources == rhs.resources &&
+            lhs.time == rhs.time;
     }
 };
 
@@ -62,7 +189,11 @@ struct BoardState {
     PlayerState enemy_units;
     bool terminal;
     bool turn;
+    // Units complete as soon as they are started, otherwise they complete after their build time
     bool simple;
+
+    // Zobrist key of the position, kept up to date by MakeMove/UnmakeMove
+    uint64_t hash;
     
     static bool equals(const BoardState& lhs, const BoardState& rhs) {
         // Compare friendly and enemy PlayerState, terminal, and turn
@@ -73,32 +204,290 @@ struct BoardState {
     }
 };
 
+static_assert(std::is_trivially_copyable_v<BoardState>, "BoardState must stay cheap to copy");
+static_assert(MacroMaxPending <= MacroMaxCompleted && MacroMaxCompleted <= 0xFF, "Pending unit counts are stored in a byte");
+
+/**
+ * @brief Precompiled data for an ability the macro search can use.
+ */
+struct MoveTemplate {
+    sc2::ABILITY_ID ability;
+    sc2::UNIT_TYPEID unit;
+    // Index of unit in MacroUnitTypes
+    uint8_t index;
+    // Mask of MacroUnitTypes indices that have to be owned
+    uint64_t requirements;
+    scdata::ResourcePair cost;
+    int32_t supply;
+    // Build time in seconds
+    float build_time;
+};
+
 struct MoveSequence {
     double score;
     std::vector<Move> moves;
+    // The search depth this sequence was completed at, 0 for a line of an interrupted first iteration
+    int32_t depth;
+
+    MoveSequence(double s = 0.0, std::vector<Move> m = {}, int32_t d = 0) : score(s), moves(m), depth(d) {}
+};
+
+/**
+ * @brief Algorithm the macro search workers run.
+ */
+enum class SearchBackend : uint8_t {
+    // Iterative deepening alpha-beta, workers share a transposition table
+    AlphaBeta = 0,
+    // Monte Carlo tree search with random playouts, workers share the tree
+    MonteCarlo = 1,
+    // Keeps the best states of every time slice for a plan over a long horizon, workers split the expansion
+    Beam = 2
+};
+
+/**
+ * @brief Tunable parameters of the macro search.
+ */
+struct SearchOptions {
+    SearchBackend backend = static_cast<SearchBackend>(MACRO_SEARCH_BACKEND);
+    // Deepest iteration to search, for Monte Carlo the length of the best line and for beam search the time slices
+    int32_t max_depth = MacroMaxPly - 2;
+    // Search every move after the first with a null window, and only search it fully if it turns out better
+    bool principal_variation = MACRO_PRINCIPAL_VARIATION_SEARCH;
+    // Width of the null window
+    double null_window = 1.0;
+    // Half width of the window around the previous score that each iteration starts with, 0 for a full window
+    double aspiration_window = MACRO_ASPIRATION_WINDOW;
+    // Search moves ordered late with less depth, and only search them fully if they turn out better
+    bool late_move_reductions = MACRO_LATE_MOVE_REDUCTIONS;
+    // Remaining depth and number of moves already searched before moves are reduced
+    int32_t reduction_depth = 3;
+    size_t reduction_moves = 3;
+    // Let the side to move pass with less depth, if it is still good enough the node is cut off without a search
+    bool null_move_pruning = MACRO_NULL_MOVE_PRUNING;
+    // Remaining depth before null moves are tried and the depth they take off in addition to the pass itself
+    int32_t null_move_depth = 3;
+    int32_t null_move_reduction = 2;
+    // Weight of the exploration term of the upper confidence bound
+    double exploration = 1.0;
+    // Evaluation difference that is worth a reward of about 0.73, evaluations are squashed into rewards with a logistic
+    double reward_scale = 1000.0;
+    // Playouts that have to end in a leaf before it is expanded, keeps the pool for the lines that matter
+    int32_t expansion_visits = 8;
+    // Random moves played from a leaf before it is evaluated
+    int32_t playout_depth = 16;
+    // Visits a node needs before it is part of the best line
+    int32_t line_visits = 16;
+    // Playouts after which the search finishes on its own, 0 for no limit
+    uint64_t max_playouts = 0;
+    // States kept per time slice of the beam search
+    size_t beam_width = MACRO_BEAM_WIDTH;
+    // Seconds of game time the beam search plans ahead
+    float horizon = 240.0f;
+    // Longest wait of a move that waits until its unit is affordable, 0 to only generate affordable units
+    float max_wait = MACRO_MAX_WAIT;
+};
+
+/**
+ * @brief Counters collected by a search thread during a single search.
+ */
+struct SearchStatistics {
+    uint64_t nodes = 0;
+    // Transposition table lookups, the ones that found the position and the ones that ended the search of a node
+    uint64_t tt_probes = 0;
+    uint64_t tt_hits = 0;
+    uint64_t tt_cutoffs = 0;
+    // Null window searches and the ones that had to be repeated with the full window
+    uint64_t pvs_searches = 0;
+    uint64_t pvs_researches = 0;
+    // Iterations that had to be repeated with a wider aspiration window
+    uint64_t aspiration_researches = 0;
+    // Moves searched with reduced depth and the ones that had to be searched again at full depth
+    uint64_t reductions = 0;
+    uint64_t reduction_researches = 0;
+    // Nodes spent on reduced searches that did not have to be repeated
+    uint64_t reduction_nodes = 0;
+    // Null moves tried, the ones that cut off the node, and the nodes spent on them
+    uint64_t null_moves = 0;
+    uint64_t null_move_cutoffs = 0;
+    uint64_t null_move_nodes = 0;
+    // Monte Carlo playouts and the nodes the tree had when the search finished
+    uint64_t playouts = 0;
+    uint64_t tree_nodes = 0;
+    // Beam search children dropped because a child with the same hash scored better
+    uint64_t beam_duplicates = 0;
+    // Moves of the result that were taken from the opening book instead of searched
+    uint64_t book_moves = 0;
+    // Deepest completed iteration
+    int32_t depth = 0;
+
+    void Add(const SearchStatistics& other) {
+        nodes += other.nodes;
+        tt_probes += other.tt_probes;
+        tt_hits += other.tt_hits;
+        tt_cutoffs += other.tt_cutoffs;
+        pvs_searches += other.pvs_searches;
+        pvs_researches += other.pvs_researches;
+        aspiration_researches += other.aspiration_researches;
+        reductions += other.reductions;
+        reduction_researches += other.reduction_researches;
+        reduction_nodes += other.reduction_nodes;
+        null_moves += other.null_moves;
+        null_move_cutoffs += other.null_move_cutoffs;
+        null_move_nodes += other.null_move_nodes;
+        playouts += other.playouts;
+        tree_nodes = std::max(tree_nodes, other.tree_nodes);
+        beam_duplicates += other.beam_duplicates;
+        book_moves += other.book_moves;
+        depth = std::max(depth, other.depth);
+    }
+};
 
-    MoveSequence(double s = 0.0, std::vector<Move> m = {}) : score(s), moves(m) {}
+/**
+ * @brief Deepest line a search has completed so far, shared between its workers and its promise.
+ *
+ * The sequence is only ever replaced as a whole with the atomic shared_ptr functions, so a reader keeps a consistent
+ * line while the workers publish deeper ones.
+ */
+struct ResultSnapshot {
+    std::shared_ptr<const MoveSequence> sequence;
 };
 
-struct TranspositionEntry {
+/**
+ * @brief State owned by a single search thread.
+ */
+struct SearchContext {
+    // Index of the thread, 0 is the main thread
+    int32_t id;
+    // Stop request of the current search, shared with the thread that completes it
+    std::stop_source cancellation;
+    // Set once the stop request has been seen, the alpha-beta search only reads the request every few nodes
+    bool stopped;
+    std::shared_ptr<ResultSnapshot> snapshot;
+    SearchOptions options;
+    SearchStatistics statistics;
+
+    // Triangular principal variation table, pv[ply] holds the best line found from ply onwards
+    std::array<std::array<Move, MacroMaxPly>, MacroMaxPly> pv;
+    std::array<int32_t, MacroMaxPly> pv_length;
+
+    // Two encoded quiet moves per ply that caused a cutoff, cleared every search
+    std::array<std::array<uint16_t, 2>, MacroMaxPly> killers;
+
+    // Cutoff history per side and unit index, the pass move is at MacroUnitCount. Aged every search.
+    std::array<std::array<int32_t, MacroUnitCount + 1>, 2> history;
+
+    // Whether the move into ply was a null move, two null moves in a row prove nothing
+    std::array<bool, MacroMaxPly> null_move;
+
+    // State of the random number generator of the Monte Carlo playouts
+    uint64_t random;
+};
+
+/**
+ * @brief Synchronisation between the persistent search workers and the searches they are given.
+ */
+struct SearchControl {
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    // Incremented every time the workers are given a new root
+    uint64_t generation = 0;
+
+    // Number of workers that have not yet finished the current root
+    uint32_t running = 0;
+
+    bool shutdown = false;
+
+    BoardState root {};
+    SearchOptions options;
+    std::stop_source cancellation;
+    std::shared_ptr<ResultSnapshot> snapshot;
+    std::vector<std::shared_ptr<MoveSequence>> results;
+    std::vector<std::shared_ptr<SearchStatistics>> statistics;
+};
+
+/**
+ * @brief A child in the beam search, only the state it is reached from and the move are kept until it is selected.
+ */
+struct BeamCandidate {
+    uint64_t hash;
     double score;
-    int32_t depth;
-    double alpha;
-    double beta;
-    std::vector<Move> bestMoveSequence;
+    uint32_t parent;
+    Move move;
+};
+
+/**
+ * @brief How a state in the beam was reached from the previous time slice.
+ */
+struct BeamStep {
+    uint32_t parent;
+    Move move;
+    // The move of the other player that completes the time slice
+    Move reply;
+};
+
+/**
+ * @brief Shared state of the workers during a beam search.
+ *
+ * Every time slice the workers expand their share of the beam into their own candidate list and meet at the
+ * barrier, the main worker selects the next beam while the others wait at the barrier again.
+ */
+struct BeamControl {
+    BeamControl(size_t workers) : barrier(static_cast<std::ptrdiff_t>(workers)), candidates(workers) {}
+
+    std::barrier<> barrier;
+
+    std::vector<BoardState> states;
+    std::vector<std::vector<BeamCandidate>> candidates;
+    // One entry per time slice with one step per state of the beam, best state first
+    std::vector<std::vector<BeamStep>> steps;
+    // Set by the main worker, read by every worker after the second barrier
+    bool finished = false;
 };
 
 class MacroPromise {
     friend class Macro;
 public:
+    /**
+     * @brief Stop the search and wait for the search workers to park.
+     * 
+     * @return The deepest completed result of any search worker
+     */
     std::shared_ptr<MoveSequence> Complete();
 
+    /**
+     * @brief Wait for the search workers to finish without stopping them, only returns early with a depth limit.
+     */
+    void Wait();
+
+    /**
+     * @brief Get the deepest line completed so far without stopping or waiting for the search.
+     * 
+     * The alpha-beta search publishes every completed iteration, the Monte Carlo search its most visited line
+     * every few hundred playouts and the beam search every time slice.
+     * 
+     * @return The line, or nullptr if no iteration has completed yet. A new line is a new object, so comparing
+     * the pointers tells if anything changed.
+     */
+    std::shared_ptr<const MoveSequence> Peek() const;
+
+    /**
+     * @brief Get the counters of the search, summed over all search workers.
+     * 
+     * @note Only valid once the search has completed
+     * @return The statistics of the search
+     */
+    SearchStatistics GetStatistics() const;
+
     ~MacroPromise();
 
 private:
-    std::shared_ptr<bool> m_CancellationToken;
-    std::shared_ptr<MoveSequence> m_Result;
-    std::thread m_Thread;
+    std::shared_ptr<SearchControl> m_Control;
+    uint64_t m_Generation;
+    std::stop_source m_Cancellation;
+    std::shared_ptr<ResultSnapshot> m_Snapshot;
+    std::vector<std::shared_ptr<MoveSequence>> m_Results;
+    std::vector<std::shared_ptr<SearchStatistics>> m_Statistics;
 };
 
 class Macro {
@@ -110,6 +499,13 @@ public:
      */
     Macro(std::shared_ptr<Collective> collective);
 
+    /**
+     * @brief Construct a Macro object that is not attached to a game, it can only search given states.
+     * 
+     * @param unit_types The unit type data of the game
+     */
+    Macro(const sc2::UnitTypes& unit_types);
+
     /**
      * @brief Destroy the Macro object
      */
@@ -123,19 +519,145 @@ public:
     /**
      * @brief Start searching for the best move sequence.
      * 
+     * The search workers are kept alive between searches, a new search stops the previous one and
+     * re-roots the workers on the current state. The transposition table and the per-worker search
+     * tables are kept, so the new search starts warm.
+     * 
      * @return A promise with the result of the search that can be completed later
      */
     std::shared_ptr<MacroPromise> Search();
 
+    /**
+     * @brief Start searching for the best move sequence from a given state.
+     * 
+     * Only the units, planned units, pending units, resources, time, turn and model of the state have to be set,
+     * the aggregates and the hash are computed.
+     * 
+     * @param state The state to search from
+     * @return A promise with the result of the search that can be completed later
+     */
+    std::shared_ptr<MacroPromise> Search(BoardState state);
+
+    /**
+     * @brief Set the memory budget of the transposition table, clearing it and stopping the search workers.
+     * 
+     * @param megabytes The memory budget in megabytes
+     */
+    void SetTranspositionTableSize(size_t megabytes);
+
+    /**
+     * @brief Set the number of threads used by the next searches, stopping the search workers.
+     * 
+     * @param threads The number of threads, 0 to use all but one hardware thread
+     */
+    void SetSearchThreads(uint32_t threads);
+
+    /**
+     * @brief Limit the depth of the next searches, they finish on their own once the depth is reached.
+     * 
+     * @param depth The deepest iteration to search
+     */
+    void SetMaxDepth(int32_t depth);
+
+    /**
+     * @brief Set the parameters of the next searches.
+     * 
+     * @param options The search parameters
+     */
+    void SetSearchOptions(const SearchOptions& options);
+
+    /**
+     * @brief Get the parameters of the next searches.
+     * 
+     * @return The search parameters
+     */
+    const SearchOptions& GetSearchOptions() const;
+
+    /**
+     * @brief Set the opening book of the next searches. A search from a position in the book follows the book
+     * instead and completes immediately.
+     * 
+     * @param book The book, nullptr to always search
+     */
+    void SetOpeningBook(std::shared_ptr<const OpeningBook> book);
+
+    /**
+     * @brief Get the opening book entries for the positions along a line, to write a book from searched lines.
+     * 
+     * @param state The state the line starts from, prepared like for Search
+     * @param sequence The line with the depth it was searched to, its score is not stored
+     * @return One entry per move of the line
+     */
+    std::vector<OpeningBookEntry> GetOpeningBookEntries(BoardState state, const MoveSequence& sequence);
+
 private:
-    MoveSequence SearchBuild(
+    void BuildMoveTable();
+
+    void PrepareState(BoardState& state);
+
+    void StartWorkers();
+
+    void StopWorkers();
+
+    void SearchWorker(uint32_t id, uint64_t generation);
+
+    static void AddUnitAggregates(PlayerState& player, uint8_t index, int32_t count);
+
+    static void AddPlannedAggregates(PlayerState& player, uint8_t index, int32_t count);
+
+    static void ComputeAggregates(PlayerState& player);
+
+    static void ChangeUnitCount(BoardState& state, bool friendly, uint8_t index, int32_t count);
+
+    static void ChangePlannedCount(BoardState& state, bool friendly, uint8_t index, int32_t count);
+
+    static void AdvanceTimeline(BoardState& state, bool friendly, float time);
+
+    static void RewindTimeline(BoardState& state, bool friendly, float time);
+
+    double SearchBuild(
         int32_t depth,
         double alpha,
         double beta,
         BoardState& state,
-        std::shared_ptr<bool> cancellation_token
+        SearchContext& context,
+        int32_t ply
     );
 
+    double SearchChild(
+        int32_t depth,
+        double alpha,
+        double beta,
+        BoardState& state,
+        SearchContext& context,
+        int32_t ply,
+        bool first,
+        int32_t reduction
+    );
+
+    bool TryNullMove(
+        int32_t depth,
+        double alpha,
+        double beta,
+        BoardState& state,
+        SearchContext& context,
+        int32_t ply,
+        double& outScore
+    );
+
+    double SearchRoot(
+        int32_t depth,
+        double alpha,
+        double beta,
+        BoardState& state,
+        SearchContext& context,
+        const std::vector<Move>& moves
+    );
+
+    static void UpdatePrincipalVariation(SearchContext& context, int32_t ply, const Move& move);
+
+    static void RecordCutoff(SearchContext& context, int32_t ply, bool friendly, const std::vector<Move>& moves, size_t cutoff, int32_t depth);
+
     double EvaluateState(
         BoardState& state
     );
@@ -151,21 +673,49 @@ private:
     );
 
     std::vector<Move> GetPossibleMoves(
-        BoardState& state, float timestep
+        BoardState& state, float timestep, float max_wait
     );
 
+    static scdata::ResourcePair GetIncome(const PlayerState& player, float timestep);
+
+    static float GetAffordableWait(const PlayerState& player, const scdata::ResourcePair& cost);
+
+    static Move GetPassMove(const BoardState& state, float timestep);
+
     void GetBestMove(
         BoardState& state,
-        std::shared_ptr<bool> cancellation_token,
+        SearchContext& context,
+        std::shared_ptr<MoveSequence> result_ptr
+    );
+
+    void SearchMonteCarlo(
+        const BoardState& root,
+        SearchContext& context,
         std::shared_ptr<MoveSequence> result_ptr
     );
 
+    double Playout(BoardState& state, int32_t ply, SearchContext& context);
+
+    void SearchBeam(
+        const BoardState& root,
+        SearchContext& context,
+        std::shared_ptr<MoveSequence> result_ptr
+    );
+
+    void SelectBeam(const BoardState& root, SearchContext& context, std::shared_ptr<MoveSequence> result_ptr);
+
+    Move MakeBeamSlice(BoardState& state, const Move& move);
+
     double MoveHeuristic(
         const Move& move
     );
 
     void SortMoves(
-        std::vector<Move>& moves
+        std::vector<Move>& moves,
+        const SearchContext& context,
+        int32_t ply,
+        bool friendly,
+        uint16_t tt_move
     );
 
     double EvaluatePlayer(
@@ -180,13 +730,43 @@ private:
 
     uint64_t ComputeHash(const BoardState& state);
 
-    bool LookupTranspositionTable(const BoardState& state, int32_t depth, double alpha, double beta, MoveSequence& outResult);
+    bool LookupTranspositionTable(const BoardState& state, int32_t depth, double alpha, double beta, double& outScore, uint16_t& outMove, SearchStatistics& statistics);
+
+    void SaveToTranspositionTable(const BoardState& state, double score, int32_t depth, double alpha, double beta, uint16_t move);
+
+    bool ProbeOpeningBook(BoardState state, MoveSequence& sequence);
 
-    void SaveToTranspositionTable(const BoardState& state, double score, int32_t depth, double alpha, double beta, const MoveSequence& bestSequence);
+    void ExtendFromTranspositionTable(BoardState state, MoveSequence& sequence, int32_t length, float max_wait);
+
+    static uint16_t EncodeMove(const Move& move);
 
     BoardState GetState();
     
-    std::unordered_map<uint64_t, TranspositionEntry> m_TranspositionTable;
+    TranspositionTable m_TranspositionTable;
+
+    // Only allocated once a Monte Carlo search is started
+    std::unique_ptr<MonteCarloTree> m_Tree;
+
+    // Only allocated while a beam search runs
+    std::unique_ptr<BeamControl> m_Beam;
+
+    std::shared_ptr<const OpeningBook> m_OpeningBook;
+
+    std::vector<MoveTemplate> m_MoveTable;
+
+    // Static ordering score per unit index, the pass move is at MacroUnitCount
+    std::array<double, MacroUnitCount + 1> m_MoveHeuristics;
+
+    uint32_t m_SearchThreads;
+
+    SearchOptions m_SearchOptions;
+
+    std::shared_ptr<SearchControl> m_Control;
+
+    std::vector<std::thread> m_Workers;
+
+    // One context per worker, kept between searches
+    std::vector<std::unique_ptr<SearchContext>> m_Contexts;
 
     std::shared_ptr<Collective> m_Collective;
 
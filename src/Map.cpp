@@ -1,12 +1,15 @@
 #include "Map.h"
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include <sc2api/sc2_common.h>
 #include <sc2api/sc2_agent.h>
 #include <sc2api/sc2_unit.h>
 #include <sc2api/sc2_interfaces.h>
 #include <sc2api/sc2_map_info.h>
 
+#include "Config.h"
 #include "Utilities.h"
 
 // Helper function to generate placement queries within a specified radius.
@@ -81,9 +84,69 @@ sc2::Point2D scbot::Map::FindClosestValidPoint(
     return closest_point;
 }
 
+namespace {
+
+// Answers placement queries from the local grid instead of the game
+std::vector<bool> LocalPlacement(const scbot::PlacementGrid& grid, const std::vector<sc2::QueryInterface::PlacementQuery>& queries)
+{
+    std::vector<bool> results(queries.size());
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+        results[i] = grid.CanPlace(static_cast<sc2::ABILITY_ID>(queries[i].ability), queries[i].target_pos);
+    }
+
+    return results;
+}
+
+sc2::Point2D PlaceClosest(
+    const scbot::PlacementGrid& grid,
+    const std::vector<sc2::QueryInterface::PlacementQuery>& queries,
+    const sc2::Point2D& pivot,
+    bool prefer_distance = true)
+{
+    return scbot::Map::FindClosestValidPoint(queries, LocalPlacement(grid, queries), pivot, prefer_distance);
+}
+
+// Points on rings around a center, at most one per cell in a row
+std::vector<sc2::Point2D> GenerateRingPoints(
+    const sc2::Point2D& center,
+    float min_radius,
+    float max_radius,
+    float step_size)
+{
+    sc2::Point2D current_grid;
+
+    sc2::Point2D previous_grid;
+
+    std::vector<sc2::Point2D> points;
+
+    for (float r = min_radius; r < max_radius; r += 1.0f)
+    {
+        float loc = 0.0f;
+
+        while (loc < 360.0f) {
+            sc2::Point2D point = sc2::Point2D((r * std::cos((loc * 3.1415927f) / 180.0f)) + center.x,
+                                    (r * std::sin((loc * 3.1415927f) / 180.0f)) + center.y);
+
+            current_grid = sc2::Point2D(std::floor(point.x), std::floor(point.y));
+
+            if (previous_grid != current_grid) {
+                points.push_back(point);
+            }
+
+            previous_grid = current_grid;
+            loc += step_size;
+        }
+    }
+
+    return points;
+}
+
+}
+
 // Refactored GetClosestPlace functions.
 sc2::Point2D scbot::Map::GetClosestPlace(
-    sc2::QueryInterface* query,
+    const PlacementGrid& grid,
     const sc2::Point2D& center,
     sc2::ABILITY_ID ability_id,
     float min_radius,
@@ -91,11 +154,11 @@ sc2::Point2D scbot::Map::GetClosestPlace(
     float step_size
 )
 {
-    return scbot::Map::GetClosestPlace(query, center, center, ability_id, min_radius, max_radius, step_size);
+    return scbot::Map::GetClosestPlace(grid, center, center, ability_id, min_radius, max_radius, step_size);
 }
 
 sc2::Point2D scbot::Map::GetClosestPlace(
-    sc2::QueryInterface* query,
+    const PlacementGrid& grid,
     const sc2::Point2D& center,
     const sc2::Point2D& pivot,
     sc2::ABILITY_ID ability_id,
@@ -105,12 +168,11 @@ sc2::Point2D scbot::Map::GetClosestPlace(
 )
 {
     auto queries = scbot::Map::GeneratePlacementQueries(center, ability_id, min_radius, max_radius, step_size);
-    auto result = query->Placement(queries);
-    return scbot::Map::FindClosestValidPoint(queries, result, pivot);
+    return PlaceClosest(grid, queries, pivot);
 }
 
 sc2::Point2D scbot::Map::GetClosestPlace(
-    sc2::QueryInterface* query,
+    const PlacementGrid& grid,
     const sc2::Point2D& center,
     const sc2::Point2D& pivot,
     const sc2::Units& pylons,
@@ -121,12 +183,11 @@ sc2::Point2D scbot::Map::GetClosestPlace(
 )
 {
     auto queries = scbot::Map::GeneratePlacementQueries(center, ability_id, min_radius, max_radius, step_size, &pylons, 5.0f);
-    auto result = query->Placement(queries);
-    return scbot::Map::FindClosestValidPoint(queries, result, pivot);
+    return PlaceClosest(grid, queries, pivot);
 }
 
 sc2::Point2D scbot::Map::GetClosestPlace(
-    sc2::QueryInterface* query,
+    const PlacementGrid& grid,
     const sc2::Point2D& pivot,
     const sc2::Units& pylons,
     sc2::ABILITY_ID ability_id,
@@ -142,29 +203,27 @@ sc2::Point2D scbot::Map::GetClosestPlace(
 
     for (const auto& pylon : sorted_pylons) {
         auto queries = scbot::Map::GeneratePlacementQueries(pylon->pos, ability_id, min_radius, max_radius, step_size);
-        auto result = query->Placement(queries);
-        sc2::Point2D point = scbot::Map::FindClosestValidPoint(queries, result, pivot);
+        sc2::Point2D point = PlaceClosest(grid, queries, pivot);
         if (point != sc2::Point2D(0.0f, 0.0f)) return point;
     }
 
     return sc2::Point2D(0.0f, 0.0f);
 }
 
-sc2::Point2D scbot::Map::GetClosestPlaceWhileAvoiding(sc2::QueryInterface* query, const sc2::Point2D& center, const sc2::Point2D& pivot, const sc2::Units& avoid, sc2::ABILITY_ID ability_id, float min_radius, float max_radius, float avoid_radius, bool prefer_distance, float step_size)
+sc2::Point2D scbot::Map::GetClosestPlaceWhileAvoiding(const PlacementGrid& grid, const sc2::Point2D& center, const sc2::Point2D& pivot, const sc2::Units& avoid, sc2::ABILITY_ID ability_id, float min_radius, float max_radius, float avoid_radius, bool prefer_distance, float step_size)
 {
     auto queries = scbot::Map::GeneratePlacementQueries(center, ability_id, min_radius, max_radius, step_size, nullptr, 0.0f, &avoid, avoid_radius);
-    auto result = query->Placement(queries);
-    return scbot::Map::FindClosestValidPoint(queries, result, pivot, prefer_distance);
+    return PlaceClosest(grid, queries, pivot, prefer_distance);
 }
 
-sc2::Point2D scbot::Map::GetBestCenter(sc2::QueryInterface* query, const sc2::Units& units, sc2::ABILITY_ID ability_id, float min_radius, float max_radius, float benchmark_radius, float step_size)
+sc2::Point2D scbot::Map::GetBestCenter(const PlacementGrid& grid, const sc2::Units& units, sc2::ABILITY_ID ability_id, float min_radius, float max_radius, float benchmark_radius, float step_size)
 {
     auto best_center = sc2::Point2D(0.0f, 0.0f);
     int best_count = 0;
 
     for (const auto& unit : units) {
         auto queries = scbot::Map::GeneratePlacementQueries(unit->pos, ability_id, min_radius, max_radius, step_size);
-        auto result = query->Placement(queries);
+        auto result = LocalPlacement(grid, queries);
 
         for (size_t i = 0; i < result.size(); ++i) {
             if (!result[i]) continue;
@@ -183,166 +242,212 @@ sc2::Point2D scbot::Map::GetBestCenter(sc2::QueryInterface* query, const sc2::Un
     return best_center;
 }
 
-std::pair<sc2::Point2D, float> scbot::Map::GetBestPath(sc2::QueryInterface* query, const sc2::Unit* unit, const sc2::Point2D &center, float min_radius, float max_radius, float step_size)
+std::pair<sc2::Point2D, float> scbot::Map::GetBestPath(const PathingGrid& grid, const sc2::Unit* unit, const sc2::Point2D& center, float min_radius, float max_radius, float step_size)
 {
-    sc2::Point2D current_grid;
+    const auto goals = GenerateRingPoints(center, min_radius, max_radius, step_size);
 
-    sc2::Point2D previous_grid;
-
-    int valid_queries = 0;
-
-    std::vector<sc2::QueryInterface::PathingQuery> queries;
+    if (goals.size() == 0) {
+        return std::make_pair(center, 0.0f);
+    }
 
-    for (float r = min_radius; r < max_radius; r += 1.0f)
-    {
-        float loc = 0.0f;
+    // One search for the whole ring instead of a path per point
+    const auto closest = grid.ClosestGoal(unit->pos, goals);
 
-        while (loc < 360.0f) {
-            sc2::Point2D point = sc2::Point2D((r * std::cos((loc * 3.1415927f) / 180.0f)) + center.x,
-                                    (r * std::sin((loc * 3.1415927f) / 180.0f)) + center.y);
+    if (!closest.has_value()) {
+        return std::make_pair(center, std::numeric_limits<float>::max());
+    }
 
-            current_grid = sc2::Point2D(std::floor(point.x), std::floor(point.y));
+    return std::make_pair(goals[closest->first], closest->second);
+}
 
-            if (previous_grid != current_grid) {
-                sc2::QueryInterface::PathingQuery query{unit->tag, unit->pos, point};
-                queries.push_back(query);
-                ++valid_queries;
-            }
+std::vector<scdata::Ramp> scbot::Map::FindRamps(sc2::QueryInterface* query, const sc2::ObservationInterface* observation)
+{
+    const auto& gameInfo = observation->GetGameInfo();
 
-            previous_grid = current_grid;
-            loc += step_size;
-        }
-    }
+    const auto min_x = static_cast<int32_t>(gameInfo.playable_min.x);
+    const auto min_y = static_cast<int32_t>(gameInfo.playable_min.y);
+    const auto width = static_cast<int32_t>(gameInfo.playable_max.x) - min_x;
+    const auto height = static_cast<int32_t>(gameInfo.playable_max.y) - min_y;
 
-    if (queries.size() == 0) {
-        return std::make_pair(center, 0.0f);
+    if (width <= 0 || height <= 0) {
+        return {};
     }
 
-    auto result = query->PathingDistance(queries);
+    const size_t cells = static_cast<size_t>(width) * static_cast<size_t>(height);
 
-    // Find the shortest path.
-    auto best_path = center;
-    auto shortest_distance = std::numeric_limits<float>::max();
+    // Union-find over the cells that are pathable but not placeable, -1 for every other cell
+    std::vector<int32_t> parent(cells, -1);
+    std::vector<float> heights(cells, 0.0f);
 
-    for (auto i = 0; i < result.size(); ++i) {
-        if (result[i] <= 0.0f) {
-            continue;
+    const auto find = [&parent](int32_t cell) {
+        while (parent[cell] != cell) {
+            parent[cell] = parent[parent[cell]];
+            cell = parent[cell];
         }
 
-        const auto& point = queries[i].end_;
+        return cell;
+    };
 
-        if (result[i] < shortest_distance) {
-            best_path = point;
-            shortest_distance = result[i];
+    const auto unite = [&parent, &find](int32_t a, int32_t b) {
+        a = find(a);
+        b = find(b);
+
+        // The lower index stays the root, so that the labels do not depend on the order of the unions
+        if (a != b) {
+            parent[std::max(a, b)] = std::min(a, b);
         }
-    }
+    };
 
-    return std::make_pair(best_path, shortest_distance);
-}
+    // Single pass, each cell is joined with its left and lower neighbours that have been seen already
+    for (int32_t y = 0; y < height; ++y) {
+        for (int32_t x = 0; x < width; ++x) {
+            const auto point = sc2::Point2D(min_x + x + 0.5f, min_y + y + 0.5f);
 
-std::vector<scdata::Ramp> scbot::Map::FindRamps(sc2::QueryInterface* query, const sc2::ObservationInterface* observation)
-{
-    const auto& gameInfo = observation->GetGameInfo();
+            if (!observation->IsPathable(point) || observation->IsPlacable(point)) {
+                continue;
+            }
 
-    std::vector<sc2::Point3D> rampTerrain;
-    std::unordered_set<float> playableHeights;
+            const int32_t cell = y * width + x;
+            parent[cell] = cell;
+            heights[cell] = observation->TerrainHeight(point);
 
-    for (auto i = gameInfo.playable_min.x; i < gameInfo.playable_max.x; i++)
-    {
-        for (auto j = gameInfo.playable_min.y; j < gameInfo.playable_max.y; j++)
-        {
-            const auto& point = sc2::Point2D(i, j);
-            const auto& pathing = observation->IsPathable(point);
-            const auto& placement = observation->IsPlacable(point);
-            const auto height = observation->TerrainHeight(point);
-
-            if (placement)
-            {
-                playableHeights.insert(height);
+            if (x > 0 && parent[cell - 1] >= 0) {
+                unite(cell, cell - 1);
             }
 
-            if (pathing && !placement)
-            {
-                rampTerrain.push_back(sc2::Point3D(point.x, point.y, height));
+            if (y > 0 && parent[cell - width] >= 0) {
+                unite(cell, cell - width);
             }
         }
     }
 
-    // Filter out those points which are not within 0.3 of a playable height.
-    for (auto i = 0; i < rampTerrain.size(); i++)
-    {
-        const auto& point = rampTerrain[i];
-        
-        auto found = false;
-
-        for (auto height : playableHeights)
-        {
-            if (std::abs(point.z - height) < 0.3f)
-            {
-                found = true;
-                break;
-            }
+    struct Region {
+        int32_t count = 0;
+        int32_t first = 0;
+        float sum_x = 0.0f;
+        float sum_y = 0.0f;
+        int32_t min_x = std::numeric_limits<int32_t>::max();
+        int32_t min_y = std::numeric_limits<int32_t>::max();
+        int32_t max_x = std::numeric_limits<int32_t>::min();
+        int32_t max_y = std::numeric_limits<int32_t>::min();
+        float min_height = std::numeric_limits<float>::max();
+        float max_height = std::numeric_limits<float>::lowest();
+    };
+
+    // Running bounds of every region, indexed through the label of its root
+    std::vector<int32_t> label(cells, -1);
+    std::vector<Region> regions;
+
+    for (int32_t cell = 0; cell < static_cast<int32_t>(cells); ++cell) {
+        if (parent[cell] < 0) {
+            continue;
         }
 
-        if (!found)
-        {
-            rampTerrain.erase(rampTerrain.begin() + i);
-            i--;
-        }
-    }
+        const auto root = find(cell);
 
-    // Cluster the points.
-    auto clusters = std::vector<std::pair<sc2::Point3D, std::vector<sc2::Point3D>>>();
+        if (label[root] < 0) {
+            label[root] = static_cast<int32_t>(regions.size());
+            regions.emplace_back();
+        }
 
-    for (auto i = 0; i < rampTerrain.size(); i++)
-    {
-        const auto& point = rampTerrain[i];
-
-        auto found = false;
-
-        for (auto& cluster : clusters)
-        {
-            // Has to be within 15 units of the cluster and not different in height by more than 0.5.
-            if (sc2::DistanceSquared2D(cluster.first, point) < 7.0f * 7.0f &&
-                std::abs(cluster.first.z - point.z) < 0.5f)
-            {
-                cluster.second.push_back(point);
-                found = true;
-
-                // Recalculate the center of mass.
-                sc2::Point3D center = {0.0f, 0.0f, 0.0f};
-
-                for (auto& p : cluster.second)
-                {
-                    center.x += p.x;
-                    center.y += p.y;
-                    center.z += p.z;
-                }
+        auto& region = regions[label[root]];
+        const int32_t x = cell % width;
+        const int32_t y = cell / width;
+
+        ++region.count;
+        region.sum_x += x + 0.5f;
+        region.sum_y += y + 0.5f;
+        region.min_x = std::min(region.min_x, x);
+        region.min_y = std::min(region.min_y, y);
+        region.max_x = std::max(region.max_x, x);
+        region.max_y = std::max(region.max_y, y);
+        region.min_height = std::min(region.min_height, heights[cell]);
+        region.max_height = std::max(region.max_height, heights[cell]);
+    }
 
-                center.x /= cluster.second.size();
-                center.y /= cluster.second.size();
-                center.z /= cluster.second.size();
+    // Cells grouped by region, so that the ends of each ramp are found without another pass over the map
+    for (size_t i = 1; i < regions.size(); ++i) {
+        regions[i].first = regions[i - 1].first + regions[i - 1].count;
+    }
 
-                cluster.first = center;
+    std::vector<int32_t> members(regions.empty() ? 0 : regions.back().first + regions.back().count);
+    std::vector<int32_t> filled(regions.size(), 0);
 
-                break;
-            }
+    for (int32_t cell = 0; cell < static_cast<int32_t>(cells); ++cell) {
+        if (parent[cell] < 0) {
+            continue;
         }
 
-        if (!found)
-        {
-            clusters.push_back({point, {point}});
-        }
+        const auto index = label[find(cell)];
+        members[regions[index].first + filled[index]++] = cell;
     }
 
     auto ramps = std::vector<scdata::Ramp>();
 
-    ramps.resize(clusters.size());
+    for (const auto& region : regions) {
+        // Flat regions are decoration or the edges of the map, not ramps between two levels
+        if (region.count < RAMP_MIN_CELLS || region.max_height - region.min_height < RAMP_MIN_HEIGHT_DIFFERENCE) {
+            continue;
+        }
+
+        const auto begin = members.begin() + region.first;
+        const auto end = begin + region.count;
 
-    for (auto i = 0; i < clusters.size(); i++)
-    {
-        ramps[i].point = clusters[i].first;
+        const auto on_side = [&region](float h, bool top) {
+            return top ? h >= region.max_height - RAMP_SIDE_TOLERANCE : h <= region.min_height + RAMP_SIDE_TOLERANCE;
+        };
+
+        const auto side_center = [&](bool top) {
+            sc2::Point2D sum(0.0f, 0.0f);
+            int32_t count = 0;
+
+            for (auto it = begin; it != end; ++it) {
+                if (on_side(heights[*it], top)) {
+                    sum += sc2::Point2D(*it % width + 0.5f, *it / width + 0.5f);
+                    ++count;
+                }
+            }
+
+            return sum / static_cast<float>(count);
+        };
+
+        scdata::Ramp ramp;
+        ramp.point = sc2::Point2D(min_x + region.sum_x / region.count, min_y + region.sum_y / region.count);
+        ramp.min = sc2::Point2D(static_cast<float>(min_x + region.min_x), static_cast<float>(min_y + region.min_y));
+        ramp.max = sc2::Point2D(static_cast<float>(min_x + region.max_x + 1), static_cast<float>(min_y + region.max_y + 1));
+        ramp.top_height = region.max_height;
+        ramp.bottom_height = region.min_height;
+
+        const auto top = side_center(true);
+        const auto bottom = side_center(false);
+        ramp.top = top + sc2::Point2D(static_cast<float>(min_x), static_cast<float>(min_y));
+        ramp.bottom = bottom + sc2::Point2D(static_cast<float>(min_x), static_cast<float>(min_y));
+
+        // Each end is measured across the line from the bottom to the top
+        auto axis = top - bottom;
+        const auto length = std::sqrt(axis.x * axis.x + axis.y * axis.y);
+        axis = length > 0.0f ? axis / length : sc2::Point2D(1.0f, 0.0f);
+        const auto across = sc2::Point2D(-axis.y, axis.x);
+
+        const auto side_width = [&](bool top) {
+            float low = std::numeric_limits<float>::max();
+            float high = std::numeric_limits<float>::lowest();
+
+            for (auto it = begin; it != end; ++it) {
+                if (on_side(heights[*it], top)) {
+                    const float projection = (*it % width + 0.5f) * across.x + (*it / width + 0.5f) * across.y;
+                    low = std::min(low, projection);
+                    high = std::max(high, projection);
+                }
+            }
+
+            return high - low + 1.0f;
+        };
+
+        ramp.choke_width = std::min(side_width(true), side_width(false));
+
+        ramps.push_back(ramp);
     }
-    
+
     return ramps;
 }
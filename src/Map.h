@@ -5,6 +5,8 @@
 #include <sc2api/sc2_interfaces.h>
 
 #include "Data.h"
+#include "PathingGrid.h"
+#include "PlacementGrid.h"
 
 namespace scbot::Map {
 
@@ -28,7 +30,7 @@ sc2::Point2D FindClosestValidPoint(
 );
 
 sc2::Point2D GetClosestPlace(
-    sc2::QueryInterface* query,
+    const PlacementGrid& grid,
     const sc2::Point2D& center, 
     sc2::ABILITY_ID ability_id, 
     float min_radius, 
@@ -37,7 +39,7 @@ sc2::Point2D GetClosestPlace(
 );
 
 sc2::Point2D GetClosestPlace(
-    sc2::QueryInterface* query,
+    const PlacementGrid& grid,
     const sc2::Point2D& center, 
     const sc2::Point2D& pivot, 
     sc2::ABILITY_ID ability_id, 
@@ -47,7 +49,7 @@ sc2::Point2D GetClosestPlace(
 );
 
 sc2::Point2D GetClosestPlace(
-    sc2::QueryInterface* query,
+    const PlacementGrid& grid,
     const sc2::Point2D& center, 
     const sc2::Point2D& pivot, 
     const sc2::Units& pylons, 
@@ -58,7 +60,7 @@ sc2::Point2D GetClosestPlace(
 );
 
 sc2::Point2D GetClosestPlace(
-    sc2::QueryInterface* query,
+    const PlacementGrid& grid,
     const sc2::Point2D& pivot, 
     const sc2::Units& pylons, 
     sc2::ABILITY_ID ability_id, 
@@ -68,7 +70,7 @@ sc2::Point2D GetClosestPlace(
 );
 
 sc2::Point2D GetClosestPlaceWhileAvoiding(
-    sc2::QueryInterface* query,
+    const PlacementGrid& grid,
     const sc2::Point2D& center, 
     const sc2::Point2D& pivot, 
     const sc2::Units& avoid, 
@@ -93,7 +95,7 @@ sc2::Point2D GetClosestPlace(
 
 
 sc2::Point2D GetBestCenter(
-    sc2::QueryInterface* query,
+    const PlacementGrid& grid,
     const sc2::Units& units, 
     sc2::ABILITY_ID ability_id, 
     float min_radius, 
@@ -103,7 +105,7 @@ sc2::Point2D GetBestCenter(
 );
 
 std::pair<sc2::Point2D, float> GetBestPath(
-    sc2::QueryInterface* query,
+    const PathingGrid& grid,
     const sc2::Unit* unit, 
     const sc2::Point2D& center, 
     float min_radius, 
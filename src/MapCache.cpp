@@ -0,0 +1,255 @@
+#include "MapCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace {
+
+constexpr char Magic[4] = {'S', 'C', 'M', 'C'};
+
+// Every section starts at a multiple of this, enough for the elements of all of them
+constexpr uint64_t SectionAlignment = 8;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t hash;
+    uint32_t section_count;
+    uint32_t reserved;
+};
+
+struct SectionEntry {
+    uint32_t kind;
+    uint32_t element_size;
+    uint64_t offset;
+    uint64_t count;
+};
+
+static_assert(sizeof(Header) == 24 && sizeof(SectionEntry) == 24, "The layout of the header is part of the file format");
+
+// FNV-1a, stable across compilers and platforms unlike std::hash
+uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const auto* bytes = static_cast<const unsigned char*>(data);
+
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+uint64_t HashImage(uint64_t hash, const sc2::ImageData& image)
+{
+    const int32_t dimensions[] = {image.width, image.height, image.bits_per_pixel};
+
+    hash = HashBytes(hash, dimensions, sizeof(dimensions));
+
+    return HashBytes(hash, image.data.data(), image.data.size());
+}
+
+uint64_t AlignSection(uint64_t offset)
+{
+    return (offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+}
+
+}
+
+scbot::MapCache::MapCache()
+{
+    m_Open = false;
+}
+
+scbot::MapCache::~MapCache()
+{
+    Close();
+}
+
+uint64_t scbot::MapCache::Hash(const sc2::GameInfo& game_info)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    const int32_t dimensions[] = {game_info.width, game_info.height};
+    hash = HashBytes(hash, dimensions, sizeof(dimensions));
+
+    hash = HashImage(hash, game_info.terrain_height);
+    hash = HashImage(hash, game_info.pathing_grid);
+    hash = HashImage(hash, game_info.placement_grid);
+
+    return hash;
+}
+
+std::string scbot::MapCache::GetPath(const std::string& directory, uint64_t hash)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "map_%016llx.bin", static_cast<unsigned long long>(hash));
+
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool scbot::MapCache::Open(const std::string& path, uint64_t hash)
+{
+    Close();
+
+    if (!m_File.Open(path) || m_File.GetSize() < sizeof(Header)) {
+        Close();
+        return false;
+    }
+
+    const auto* header = static_cast<const Header*>(m_File.GetData());
+
+    // Results of another map, or of an older analysis, would place everything in the wrong spots
+    if (std::memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version || header->hash != hash ||
+        header->section_count > (m_File.GetSize() - sizeof(Header)) / sizeof(SectionEntry)) {
+        Close();
+        return false;
+    }
+
+    const auto* sections = reinterpret_cast<const SectionEntry*>(static_cast<const char*>(m_File.GetData()) + sizeof(Header));
+
+    // A truncated file is refused as a whole rather than section by section
+    for (uint32_t i = 0; i < header->section_count; ++i) {
+        const auto& section = sections[i];
+
+        if (section.offset > m_File.GetSize() || section.element_size == 0 ||
+            section.count > (m_File.GetSize() - section.offset) / section.element_size) {
+            Close();
+            return false;
+        }
+    }
+
+    m_Open = true;
+
+    return true;
+}
+
+void scbot::MapCache::Close()
+{
+    m_File.Close();
+
+    m_Open = false;
+}
+
+std::span<const scdata::Ramp> scbot::MapCache::GetRamps() const
+{
+    return GetSection<scdata::Ramp>(Section::Ramps);
+}
+
+std::span<const sc2::Point3D> scbot::MapCache::GetExpansions() const
+{
+    return GetSection<sc2::Point3D>(Section::Expansions);
+}
+
+template <typename T>
+std::span<const T> scbot::MapCache::GetSection(Section kind) const
+{
+    if (!m_Open) {
+        return {};
+    }
+
+    const auto* base = static_cast<const char*>(m_File.GetData());
+    const auto* header = reinterpret_cast<const Header*>(base);
+    const auto* sections = reinterpret_cast<const SectionEntry*>(base + sizeof(Header));
+
+    for (uint32_t i = 0; i < header->section_count; ++i) {
+        const auto& section = sections[i];
+
+        if (section.kind != static_cast<uint32_t>(kind)) {
+            continue;
+        }
+
+        if (section.element_size != sizeof(T) || section.offset % alignof(T) != 0) {
+            return {};
+        }
+
+        return std::span<const T>(reinterpret_cast<const T*>(base + section.offset), static_cast<size_t>(section.count));
+    }
+
+    return {};
+}
+
+bool scbot::MapCache::Write(const std::string& path, uint64_t hash, const std::vector<scdata::Ramp>& ramps, const std::vector<sc2::Point3D>& expansions)
+{
+    struct Payload {
+        Section kind;
+        uint32_t element_size;
+        const void* data;
+        size_t count;
+    };
+
+    const Payload payloads[] = {
+        {Section::Ramps, sizeof(scdata::Ramp), ramps.data(), ramps.size()},
+        {Section::Expansions, sizeof(sc2::Point3D), expansions.data(), expansions.size()},
+    };
+
+    constexpr uint32_t section_count = sizeof(payloads) / sizeof(payloads[0]);
+
+    Header header {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.hash = hash;
+    header.section_count = section_count;
+
+    SectionEntry sections[section_count] {};
+    uint64_t offset = AlignSection(sizeof(Header) + sizeof(sections));
+
+    for (uint32_t i = 0; i < section_count; ++i) {
+        sections[i].kind = static_cast<uint32_t>(payloads[i].kind);
+        sections[i].element_size = payloads[i].element_size;
+        sections[i].offset = offset;
+        sections[i].count = payloads[i].count;
+
+        offset = AlignSection(offset + payloads[i].element_size * payloads[i].count);
+    }
+
+    std::error_code error;
+    const auto target = std::filesystem::path(path);
+    // Bots running at the same time may write the cache of the same map, each writes its own file and renames it
+    std::random_device random;
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", random(), random());
+    const auto temporary = std::filesystem::path(path + suffix);
+
+    if (target.has_parent_path()) {
+        std::filesystem::create_directories(target.parent_path(), error);
+    }
+
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+        if (!file) {
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(sections), sizeof(sections));
+
+        for (uint32_t i = 0; i < section_count; ++i) {
+            // Padding up to the start of the section
+            const auto padding = sections[i].offset - static_cast<uint64_t>(file.tellp());
+            const char zeros[SectionAlignment] {};
+            file.write(zeros, static_cast<std::streamsize>(padding));
+
+            file.write(static_cast<const char*>(payloads[i].data), static_cast<std::streamsize>(payloads[i].element_size * payloads[i].count));
+        }
+
+        if (!file) {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary, target, error);
+
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    return true;
+}
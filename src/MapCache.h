@@ -0,0 +1,124 @@
+#pragma once
+
+#include <sc2api/sc2_common.h>
+#include <sc2api/sc2_map_info.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Data.h"
+#include "MappedFile.h"
+
+namespace scbot
+{
+
+/**
+ * @brief Results of the analysis of a map, saved after the first game on it and mapped in the games that follow.
+ *
+ * A cache file is a header followed by a table of sections and their elements, in the byte order of the machine that
+ * wrote it. Each section holds an array of one kind of result, so results can be added to the format without changing
+ * the sections already in it. The header carries a hash of the terrain, pathing and placement grids of the map, a cache
+ * is only used for the map it was written for.
+ */
+class MapCache
+{
+public:
+    // Written into the header, a cache with another version is refused. Bump it when the layout of a section or the
+    // analysis that produces it changes.
+    static constexpr uint32_t Version = 1;
+
+    enum class Section : uint32_t {
+        Ramps = 1,
+        Expansions = 2,
+    };
+
+    static_assert(std::is_trivially_copyable_v<scdata::Ramp>, "Ramps are stored in the file as is");
+    static_assert(std::is_trivially_copyable_v<sc2::Point3D>, "Expansions are stored in the file as is");
+
+    /**
+     * @brief Construct an empty MapCache object
+     */
+    MapCache();
+
+    /**
+     * @brief Destroy the MapCache object, unmapping its file
+     */
+    ~MapCache();
+
+    MapCache(const MapCache&) = delete;
+    MapCache& operator=(const MapCache&) = delete;
+
+    /**
+     * @brief Hash the grids of a map, the key of its cache.
+     *
+     * @param game_info The game info of the map
+     * @return The hash
+     */
+    static uint64_t Hash(const sc2::GameInfo& game_info);
+
+    /**
+     * @brief Get the path of the cache of a map.
+     *
+     * @param directory The directory of the caches
+     * @param hash The hash of the map
+     * @return The path of the file
+     */
+    static std::string GetPath(const std::string& directory, uint64_t hash);
+
+    /**
+     * @brief Map a cache file, replacing the cache that is open.
+     *
+     * @param path The path of the file
+     * @param hash The hash of the map the cache has to be for
+     * @return true if the file is a cache of the current version for the map, false otherwise
+     */
+    bool Open(const std::string& path, uint64_t hash);
+
+    /**
+     * @brief Unmap the cache file, the cache is empty afterwards.
+     */
+    void Close();
+
+    /**
+     * @brief Get the ramps of the map.
+     *
+     * @return The ramps, valid until the cache is closed
+     */
+    std::span<const scdata::Ramp> GetRamps() const;
+
+    /**
+     * @brief Get the expansions of the map.
+     *
+     * @return The expansions, valid until the cache is closed
+     */
+    std::span<const sc2::Point3D> GetExpansions() const;
+
+    /**
+     * @brief Write a cache file.
+     *
+     * The file is written next to its path and renamed into place, so a bot starting at the same time never maps a
+     * partly written cache.
+     *
+     * @param path The path of the file
+     * @param hash The hash of the map
+     * @param ramps The ramps of the map
+     * @param expansions The expansions of the map
+     * @return true if the file was written, false otherwise
+     */
+    static bool Write(const std::string& path, uint64_t hash, const std::vector<scdata::Ramp>& ramps, const std::vector<sc2::Point3D>& expansions);
+
+private:
+    // Finds a section and checks that its elements have the expected size, an empty span if it is missing
+    template <typename T>
+    std::span<const T> GetSection(Section kind) const;
+
+    MappedFile m_File;
+
+    bool m_Open;
+};
+
+}
@@ -0,0 +1,127 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+scbot::MappedFile::MappedFile()
+{
+    m_View = nullptr;
+    m_ViewSize = 0;
+
+#ifdef _WIN32
+    m_File = INVALID_HANDLE_VALUE;
+    m_Mapping = nullptr;
+#else
+    m_File = -1;
+#endif
+}
+
+scbot::MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool scbot::MappedFile::Open(const std::string& path)
+{
+    Close();
+
+#ifdef _WIN32
+    m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_File, &size) || size.QuadPart <= 0) {
+        Close();
+        return false;
+    }
+
+    m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_Mapping == nullptr) {
+        Close();
+        return false;
+    }
+
+    m_ViewSize = static_cast<size_t>(size.QuadPart);
+    m_View = MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    m_File = open(path.c_str(), O_RDONLY);
+    if (m_File < 0) {
+        return false;
+    }
+
+    // Mapping an empty file fails, and there would be nothing to read
+    struct stat status;
+    if (fstat(m_File, &status) != 0 || status.st_size <= 0) {
+        Close();
+        return false;
+    }
+
+    m_ViewSize = static_cast<size_t>(status.st_size);
+    m_View = mmap(nullptr, m_ViewSize, PROT_READ, MAP_SHARED, m_File, 0);
+
+    if (m_View == MAP_FAILED) {
+        m_View = nullptr;
+    }
+#endif
+
+    if (m_View == nullptr) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void scbot::MappedFile::Close()
+{
+#ifdef _WIN32
+    if (m_View != nullptr) {
+        UnmapViewOfFile(m_View);
+    }
+
+    if (m_Mapping != nullptr) {
+        CloseHandle(m_Mapping);
+    }
+
+    if (m_File != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_File);
+    }
+
+    m_File = INVALID_HANDLE_VALUE;
+    m_Mapping = nullptr;
+#else
+    if (m_View != nullptr) {
+        munmap(m_View, m_ViewSize);
+    }
+
+    if (m_File >= 0) {
+        close(m_File);
+    }
+
+    m_File = -1;
+#endif
+
+    m_View = nullptr;
+    m_ViewSize = 0;
+}
+
+const void* scbot::MappedFile::GetData() const
+{
+    return m_View;
+}
+
+size_t scbot::MappedFile::GetSize() const
+{
+    return m_ViewSize;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace scbot
+{
+
+/**
+ * @brief A file mapped read-only into memory.
+ *
+ * Opening is instant whatever the size of the file, pages are read when they are first touched and are shared
+ * between processes that map the same file.
+ */
+class MappedFile
+{
+public:
+    /**
+     * @brief Construct a MappedFile object without a file
+     */
+    MappedFile();
+
+    /**
+     * @brief Destroy the MappedFile object, unmapping its file
+     */
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Map a file, replacing the file that is mapped.
+     *
+     * @param path The path of the file
+     * @return true if the file was mapped, false if it is missing, empty or cannot be mapped
+     */
+    bool Open(const std::string& path);
+
+    /**
+     * @brief Unmap the file.
+     */
+    void Close();
+
+    /**
+     * @brief Get the contents of the file.
+     *
+     * @return The first byte of the file, or nullptr if no file is mapped
+     */
+    const void* GetData() const;
+
+    /**
+     * @brief Get the size of the file.
+     *
+     * @return The size in bytes, 0 if no file is mapped
+     */
+    size_t GetSize() const;
+
+private:
+    // Base and length of the mapping
+    void* m_View;
+
+    size_t m_ViewSize;
+
+#ifdef _WIN32
+    void* m_File;
+
+    void* m_Mapping;
+#else
+    int m_File;
+#endif
+};
+
+}
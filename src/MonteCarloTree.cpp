@@ -0,0 +1,204 @@
+#include "MonteCarloTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Rewards are clamped before they are turned back into evaluations so that a decided line does not give infinity
+constexpr double RewardEpsilon = 1e-6;
+
+}
+
+scbot::MonteCarloTree::MonteCarloTree(size_t capacity)
+{
+    m_Capacity = std::max<size_t>(capacity, 1);
+    m_Nodes = std::make_unique<MonteCarloNode[]>(m_Capacity);
+
+    Reset();
+}
+
+scbot::MonteCarloTree::~MonteCarloTree()
+{
+}
+
+void scbot::MonteCarloTree::Reset()
+{
+    auto& root = m_Nodes[Root];
+    root.move = {true, sc2::UNIT_TYPEID::INVALID, InvalidMacroUnit, {0, 0}, 0.0f, 0.0f, 0.0f, 0.0f};
+    root.first_child = Root;
+    root.child_count = 0;
+    root.expansion.store(ExpansionState::Leaf, std::memory_order_relaxed);
+    root.visits.store(0, std::memory_order_relaxed);
+    root.virtual_loss.store(0, std::memory_order_relaxed);
+    root.reward.store(0.0, std::memory_order_relaxed);
+
+    m_Size.store(1, std::memory_order_relaxed);
+}
+
+scbot::MonteCarloNode& scbot::MonteCarloTree::GetNode(uint32_t index)
+{
+    return m_Nodes[index];
+}
+
+bool scbot::MonteCarloTree::BeginExpansion(uint32_t index)
+{
+    auto expected = ExpansionState::Leaf;
+
+    return m_Nodes[index].expansion.compare_exchange_strong(expected, ExpansionState::Expanding, std::memory_order_acquire);
+}
+
+bool scbot::MonteCarloTree::Expand(uint32_t index, const std::vector<Move>& moves)
+{
+    auto& node = m_Nodes[index];
+
+    const auto count = static_cast<uint32_t>(std::min<size_t>(moves.size(), 0xFFFF));
+    const auto first = count != 0 ? Allocate(count) : Root;
+
+    if (first == Root) {
+        node.expansion.store(ExpansionState::Leaf, std::memory_order_release);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        auto& child = m_Nodes[first + i];
+        child.move = moves[i];
+        child.first_child = Root;
+        child.child_count = 0;
+        child.expansion.store(ExpansionState::Leaf, std::memory_order_relaxed);
+        child.visits.store(0, std::memory_order_relaxed);
+        child.virtual_loss.store(0, std::memory_order_relaxed);
+        child.reward.store(0.0, std::memory_order_relaxed);
+    }
+
+    node.first_child = first;
+    node.child_count = static_cast<uint16_t>(count);
+
+    // Publishes the children, threads that see Expanded also see them
+    node.expansion.store(ExpansionState::Expanded, std::memory_order_release);
+
+    return true;
+}
+
+uint32_t scbot::MonteCarloTree::SelectChild(uint32_t index, bool friendly, double exploration) const
+{
+    const auto& node = m_Nodes[index];
+
+    const int32_t parent_visits = node.visits.load(std::memory_order_relaxed) + node.virtual_loss.load(std::memory_order_relaxed);
+    const double log_visits = std::log(static_cast<double>(std::max(parent_visits, 1)));
+
+    uint32_t best = node.first_child;
+    double best_value = -INFINITY;
+
+    for (uint32_t i = node.first_child; i < node.first_child + node.child_count; ++i) {
+        const auto& child = m_Nodes[i];
+
+        const int32_t virtual_loss = child.virtual_loss.load(std::memory_order_relaxed);
+        const int32_t visits = child.visits.load(std::memory_order_relaxed) + virtual_loss;
+
+        // Children are in move ordering order, so the first unvisited one is the most promising
+        if (visits == 0) {
+            return i;
+        }
+
+        // A virtual loss is a reward of 0 for the friendly player and of 1 for the enemy
+        const double reward = child.reward.load(std::memory_order_relaxed) + (friendly ? 0.0 : virtual_loss);
+        const double mean = reward / visits;
+        const double value = (friendly ? mean : 1.0 - mean) + exploration * std::sqrt(log_visits / visits);
+
+        if (value > best_value) {
+            best_value = value;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+void scbot::MonteCarloTree::AddVirtualLoss(uint32_t index)
+{
+    m_Nodes[index].virtual_loss.fetch_add(1, std::memory_order_relaxed);
+}
+
+void scbot::MonteCarloTree::Update(uint32_t index, double reward)
+{
+    auto& node = m_Nodes[index];
+
+    node.reward.fetch_add(reward, std::memory_order_relaxed);
+    node.visits.fetch_add(1, std::memory_order_relaxed);
+    node.virtual_loss.fetch_sub(1, std::memory_order_relaxed);
+}
+
+scbot::MoveSequence scbot::MonteCarloTree::GetBestSequence(int32_t min_visits, double scale) const
+{
+    MoveSequence sequence;
+
+    uint32_t index = Root;
+
+    while (m_Nodes[index].expansion.load(std::memory_order_acquire) == ExpansionState::Expanded) {
+        const auto& node = m_Nodes[index];
+
+        uint32_t best = Root;
+        int32_t best_visits = 0;
+
+        for (uint32_t i = node.first_child; i < node.first_child + node.child_count; ++i) {
+            const int32_t visits = m_Nodes[i].visits.load(std::memory_order_relaxed);
+
+            if (visits > best_visits) {
+                best_visits = visits;
+                best = i;
+            }
+        }
+
+        if (best == Root || best_visits < min_visits) {
+            break;
+        }
+
+        sequence.moves.push_back(m_Nodes[best].move);
+        index = best;
+    }
+
+    // The average reward of the end of the line, undo the logistic squashing of the evaluation
+    const auto& last = m_Nodes[index];
+    const int32_t visits = last.visits.load(std::memory_order_relaxed);
+
+    if (visits != 0) {
+        const double mean = std::clamp(last.reward.load(std::memory_order_relaxed) / visits, RewardEpsilon, 1.0 - RewardEpsilon);
+        sequence.score = scale * std::log(mean / (1.0 - mean));
+    }
+
+    sequence.depth = static_cast<int32_t>(sequence.moves.size());
+
+    return sequence;
+}
+
+size_t scbot::MonteCarloTree::GetSize() const
+{
+    return std::min<size_t>(m_Size.load(std::memory_order_relaxed), m_Capacity);
+}
+
+size_t scbot::MonteCarloTree::GetCapacity() const
+{
+    return m_Capacity;
+}
+
+uint32_t scbot::MonteCarloTree::Allocate(uint32_t count)
+{
+    if (m_Size.load(std::memory_order_relaxed) + count > m_Capacity) {
+        return Root;
+    }
+
+    // The size can overshoot the capacity when threads race for the last nodes, those allocations all fail
+    const uint32_t first = m_Size.fetch_add(count, std::memory_order_relaxed);
+
+    if (static_cast<size_t>(first) + count > m_Capacity) {
+        return Root;
+    }
+
+    return first;
+}
+
+bool scbot::MonteCarloTree::IsFull() const
+{
+    return m_Size.load(std::memory_order_relaxed) >= m_Capacity;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "Macro.h"
+
+namespace scbot
+{
+
+/**
+ * @brief How far a node of the Monte Carlo tree has been expanded.
+ */
+enum class ExpansionState : uint8_t {
+    Leaf = 0,
+    // A thread is generating the children, the others treat the node as a leaf until it is done
+    Expanding = 1,
+    Expanded = 2
+};
+
+/**
+ * @brief A node of the Monte Carlo tree, the position reached by playing move from its parent.
+ */
+struct MonteCarloNode {
+    Move move;
+    // Children are allocated as one contiguous block
+    uint32_t first_child;
+    uint16_t child_count;
+    std::atomic<ExpansionState> expansion;
+    std::atomic<int32_t> visits;
+    // Playouts that passed through the node and have not been backed up yet, scored as a loss for the side choosing it
+    std::atomic<int32_t> virtual_loss;
+    // Sum of the rewards of the friendly player, between 0 and 1 per visit
+    std::atomic<double> reward;
+};
+
+/**
+ * @brief Shared search tree of the Monte Carlo macro search.
+ *
+ * Nodes are taken from a pool that is allocated once and released all at once when the tree is reset, so
+ * the search threads never allocate. When the pool runs out the tree stops growing and playouts start from
+ * its leaves. All threads work on the same tree without locking, virtual loss keeps them on different lines.
+ */
+class MonteCarloTree
+{
+public:
+    // Index of the root, never a child so it also marks a failed allocation
+    static constexpr uint32_t Root = 0;
+
+    /**
+     * @brief Construct a new MonteCarloTree object
+     *
+     * @param capacity The number of nodes in the pool
+     */
+    MonteCarloTree(size_t capacity);
+
+    /**
+     * @brief Destroy the MonteCarloTree object
+     */
+    ~MonteCarloTree();
+
+    /**
+     * @brief Release every node but a fresh root.
+     *
+     * @note Must not be called while a search thread is using the tree
+     */
+    void Reset();
+
+    /**
+     * @brief Get a node.
+     *
+     * @param index The index of the node
+     * @return The node
+     */
+    MonteCarloNode& GetNode(uint32_t index);
+
+    /**
+     * @brief Claim the expansion of a leaf, only one thread gets to expand a node.
+     *
+     * @param index The index of the node
+     * @return true if the calling thread has to expand the node, false otherwise
+     */
+    bool BeginExpansion(uint32_t index);
+
+    /**
+     * @brief Add the children of a node claimed with BeginExpansion, in the order they should be tried.
+     *
+     * If the pool is out of nodes the node stays a leaf and can be claimed again.
+     *
+     * @param index The index of the node
+     * @param moves The moves that lead to the children
+     * @return true if the children were added, false otherwise
+     */
+    bool Expand(uint32_t index, const std::vector<Move>& moves);
+
+    /**
+     * @brief Pick the child of an expanded node with the best upper confidence bound, unvisited children first.
+     *
+     * @param index The index of the node
+     * @param friendly Whether the friendly player chooses the child
+     * @param exploration The exploration constant
+     * @return The index of the child
+     */
+    uint32_t SelectChild(uint32_t index, bool friendly, double exploration) const;
+
+    /**
+     * @brief Add a virtual loss to a node that a playout is about to pass through.
+     *
+     * @param index The index of the node
+     */
+    void AddVirtualLoss(uint32_t index);
+
+    /**
+     * @brief Back up the reward of a playout into a node and remove its virtual loss.
+     *
+     * @param index The index of the node
+     * @param reward The reward of the friendly player
+     */
+    void Update(uint32_t index, double reward);
+
+    /**
+     * @brief Follow the most visited children from the root.
+     *
+     * @param min_visits The visits a child needs to be part of the line
+     * @param scale The scale the evaluations were squashed into rewards with
+     * @return The line, with the average reward of its last node converted back to an evaluation
+     */
+    MoveSequence GetBestSequence(int32_t min_visits, double scale) const;
+
+    /**
+     * @brief Get the number of nodes in use.
+     *
+     * @return The size of the tree
+     */
+    size_t GetSize() const;
+
+    /**
+     * @brief Get the number of nodes in the pool.
+     *
+     * @return The capacity of the tree
+     */
+    size_t GetCapacity() const;
+
+    /**
+     * @brief Check if the pool has run out of nodes.
+     *
+     * @return true if no more nodes can be expanded, false otherwise
+     */
+    bool IsFull() const;
+
+private:
+    uint32_t Allocate(uint32_t count);
+
+    std::unique_ptr<MonteCarloNode[]> m_Nodes;
+
+    size_t m_Capacity;
+
+    std::atomic<uint32_t> m_Size;
+};
+
+}
@@ -0,0 +1,113 @@
+#include "OpeningBook.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+constexpr char Magic[4] = {'S', 'C', 'O', 'B'};
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+};
+
+static_assert(sizeof(Header) % alignof(scbot::OpeningBookEntry) == 0, "The entries must be aligned after the header");
+
+}
+
+scbot::OpeningBook::OpeningBook()
+{
+    m_Entries = nullptr;
+    m_Count = 0;
+}
+
+scbot::OpeningBook::~OpeningBook()
+{
+    Close();
+}
+
+bool scbot::OpeningBook::Open(const std::string& path)
+{
+    Close();
+
+    if (!m_File.Open(path) || m_File.GetSize() < sizeof(Header)) {
+        Close();
+        return false;
+    }
+
+    const auto* header = static_cast<const Header*>(m_File.GetData());
+
+    // A truncated file or one written for another hash would only give wrong moves
+    if (std::memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version ||
+        header->count > (m_File.GetSize() - sizeof(Header)) / sizeof(OpeningBookEntry)) {
+        Close();
+        return false;
+    }
+
+    m_Entries = reinterpret_cast<const OpeningBookEntry*>(static_cast<const char*>(m_File.GetData()) + sizeof(Header));
+    m_Count = static_cast<size_t>(header->count);
+
+    return true;
+}
+
+void scbot::OpeningBook::Close()
+{
+    m_File.Close();
+
+    m_Entries = nullptr;
+    m_Count = 0;
+}
+
+bool scbot::OpeningBook::Lookup(uint64_t hash, OpeningBookEntry& entry) const
+{
+    const auto* end = m_Entries + m_Count;
+    const auto* it = std::lower_bound(m_Entries, end, hash, [](const OpeningBookEntry& entry, uint64_t hash) {
+        return entry.hash < hash;
+    });
+
+    if (it == end || it->hash != hash) {
+        return false;
+    }
+
+    entry = *it;
+
+    return true;
+}
+
+size_t scbot::OpeningBook::GetSize() const
+{
+    return m_Count;
+}
+
+bool scbot::OpeningBook::Write(const std::string& path, std::vector<OpeningBookEntry> entries)
+{
+    // Deepest entry of a position first, so that the duplicates after it are dropped
+    std::sort(entries.begin(), entries.end(), [](const OpeningBookEntry& a, const OpeningBookEntry& b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.depth > b.depth;
+    });
+
+    const auto unique_end = std::unique(entries.begin(), entries.end(), [](const OpeningBookEntry& a, const OpeningBookEntry& b) {
+        return a.hash == b.hash;
+    });
+
+    entries.erase(unique_end, entries.end());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    if (!file) {
+        return false;
+    }
+
+    Header header {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.count = entries.size();
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(OpeningBookEntry)));
+
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace scbot
+{
+
+/**
+ * @brief A position of the opening book, stored in the file as is.
+ *
+ * Only the move is kept. The score of the searched line only holds for the position it was searched from, not for
+ * the positions further along it.
+ */
+struct OpeningBookEntry {
+    // Zobrist hash of the position
+    uint64_t hash;
+    // Best move, encoded like the moves of the transposition table
+    uint16_t move;
+    // Depth the best move was searched to from this position
+    uint16_t depth;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(OpeningBookEntry) == 16, "The layout of OpeningBookEntry is part of the file format");
+
+/**
+ * @brief Read-only table from macro positions to their best move, searched deep offline.
+ *
+ * The file is a header followed by the entries sorted by hash, in the byte order of the machine that wrote it. It is
+ * memory-mapped rather than read, so opening a large book is instant and its pages are shared between bots running
+ * on the same machine. Lookups are a binary search over the mapped entries.
+ */
+class OpeningBook
+{
+public:
+    // Written into the header, a book with another version is refused. Bump it when the hash or move encoding changes.
+    static constexpr uint32_t Version = 2;
+
+    /**
+     * @brief Construct an empty OpeningBook object
+     */
+    OpeningBook();
+
+    /**
+     * @brief Destroy the OpeningBook object, unmapping its file
+     */
+    ~OpeningBook();
+
+    OpeningBook(const OpeningBook&) = delete;
+    OpeningBook& operator=(const OpeningBook&) = delete;
+
+    /**
+     * @brief Map a book file, replacing the book that is open.
+     *
+     * @param path The path of the file
+     * @return true if the file is a book of the current version, false otherwise
+     */
+    bool Open(const std::string& path);
+
+    /**
+     * @brief Unmap the book file, the book is empty afterwards.
+     */
+    void Close();
+
+    /**
+     * @brief Look up a position.
+     *
+     * @param hash The hash of the position
+     * @param entry The entry, if found
+     * @return true if the position is in the book, false otherwise
+     */
+    bool Lookup(uint64_t hash, OpeningBookEntry& entry) const;
+
+    /**
+     * @brief Get the number of positions in the book.
+     *
+     * @return The number of entries
+     */
+    size_t GetSize() const;
+
+    /**
+     * @brief Write a book file.
+     *
+     * Entries may be given in any order. Of several entries for the same position the deepest one is kept.
+     *
+     * @param path The path of the file
+     * @param entries The positions
+     * @return true if the file was written, false otherwise
+     */
+    static bool Write(const std::string& path, std::vector<OpeningBookEntry> entries);
+
+private:
+    const OpeningBookEntry* m_Entries;
+
+    size_t m_Count;
+
+    MappedFile m_File;
+};
+
+}
@@ -0,0 +1,273 @@
+#include "PathingGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Config.h"
+
+namespace {
+
+constexpr float DiagonalCost = 1.41421356f;
+
+// Orders the open list as a min-heap on the cost
+constexpr auto Later = [](const auto& a, const auto& b) {
+    return a.cost > b.cost;
+};
+
+}
+
+scbot::PathingGrid::PathingGrid(const sc2::ObservationInterface* observation)
+{
+    NON_NULL(observation);
+
+    m_Observation = observation;
+
+    const auto& game_info = observation->GetGameInfo();
+    m_Width = game_info.width;
+    m_Height = game_info.height;
+
+    const size_t cells = static_cast<size_t>(m_Width) * static_cast<size_t>(m_Height);
+    m_Terrain.assign(cells, 0);
+    m_Blocked.assign(cells, 0);
+
+    m_Cost.assign(cells, 0.0f);
+    m_Generation.assign(cells, 0);
+    m_Closed.assign(cells, 0);
+    m_Goal.assign(cells, 0);
+    m_CurrentGeneration = 0;
+
+    // Neutral units such as minerals and rocks are part of the pathing grid the game starts with
+    for (int32_t y = 0; y < m_Height; ++y) {
+        for (int32_t x = 0; x < m_Width; ++x) {
+            m_Terrain[y * m_Width + x] = observation->IsPathable(sc2::Point2D(x + 0.5f, y + 0.5f)) ? 1 : 0;
+        }
+    }
+
+    for (const auto* unit : observation->GetUnits(sc2::Unit::Alliance::Self)) {
+        AddUnit(unit);
+    }
+}
+
+scbot::PathingGrid::~PathingGrid()
+{
+}
+
+void scbot::PathingGrid::AddUnit(const sc2::Unit* unit)
+{
+    NON_NULL(unit);
+
+    if (m_Footprints.find(unit->tag) != m_Footprints.end()) {
+        return;
+    }
+
+    Footprint footprint;
+    if (!GetFootprint(unit, footprint)) {
+        return;
+    }
+
+    m_Footprints.emplace(unit->tag, footprint);
+    Apply(footprint, 1);
+}
+
+void scbot::PathingGrid::RemoveUnit(const sc2::Unit* unit)
+{
+    NON_NULL(unit);
+
+    const auto it = m_Footprints.find(unit->tag);
+
+    if (it == m_Footprints.end()) {
+        return;
+    }
+
+    Apply(it->second, -1);
+    m_Footprints.erase(it);
+}
+
+bool scbot::PathingGrid::IsPathable(int32_t x, int32_t y) const
+{
+    if (x < 0 || y < 0 || x >= m_Width || y >= m_Height) {
+        return false;
+    }
+
+    const size_t index = static_cast<size_t>(y) * m_Width + x;
+
+    return m_Terrain[index] != 0 && m_Blocked[index] == 0;
+}
+
+std::optional<std::pair<size_t, float>> scbot::PathingGrid::ClosestGoal(const sc2::Point2D& start, const std::vector<sc2::Point2D>& goals) const
+{
+    const auto start_cell = GetCell(start);
+
+    if (!start_cell.has_value() || goals.empty()) {
+        return std::nullopt;
+    }
+
+    Reset();
+
+    bool reachable = false;
+
+    for (const auto& goal : goals) {
+        const auto goal_cell = GetCell(goal);
+
+        if (goal_cell.has_value() && IsPathable(goal_cell.value() % m_Width, goal_cell.value() / m_Width)) {
+            m_Goal[goal_cell.value()] = m_CurrentGeneration;
+            reachable = true;
+        }
+    }
+
+    if (!reachable) {
+        return std::nullopt;
+    }
+
+    const auto result = Search(start_cell.value());
+
+    if (!result.has_value()) {
+        return std::nullopt;
+    }
+
+    // Several goals can share the cell that was reached, the first of them is as close as any
+    for (size_t i = 0; i < goals.size(); ++i) {
+        if (GetCell(goals[i]) == result->first) {
+            return std::make_pair(i, result->second);
+        }
+    }
+
+    return std::nullopt;
+}
+
+bool scbot::PathingGrid::GetFootprint(const sc2::Unit* unit, Footprint& footprint) const
+{
+    if (unit->alliance != sc2::Unit::Alliance::Self || unit->is_flying) {
+        return false;
+    }
+
+    const auto& unit_types = m_Observation->GetUnitTypeData();
+    const auto index = static_cast<size_t>(static_cast<uint32_t>(unit->unit_type));
+
+    if (index >= unit_types.size()) {
+        return false;
+    }
+
+    const auto& attributes = unit_types[index].attributes;
+
+    if (std::find(attributes.begin(), attributes.end(), sc2::Attribute::Structure) == attributes.end()) {
+        return false;
+    }
+
+    // Same footprint as in the placement grid, the radius is a bit larger than half of it
+    footprint.size = std::max(static_cast<int32_t>(std::floor(unit->radius * 2.0f - 0.25f)), 1);
+    footprint.x = static_cast<int32_t>(std::lround(unit->pos.x - footprint.size * 0.5f));
+    footprint.y = static_cast<int32_t>(std::lround(unit->pos.y - footprint.size * 0.5f));
+
+    return true;
+}
+
+void scbot::PathingGrid::Apply(const Footprint& footprint, int32_t delta)
+{
+    for (int32_t y = std::max(footprint.y, 0); y < std::min(footprint.y + footprint.size, m_Height); ++y) {
+        for (int32_t x = std::max(footprint.x, 0); x < std::min(footprint.x + footprint.size, m_Width); ++x) {
+            auto& cell = m_Blocked[static_cast<size_t>(y) * m_Width + x];
+            cell = static_cast<uint8_t>(cell + delta);
+        }
+    }
+}
+
+std::optional<int32_t> scbot::PathingGrid::GetCell(const sc2::Point2D& point) const
+{
+    const auto x = static_cast<int32_t>(std::floor(point.x));
+    const auto y = static_cast<int32_t>(std::floor(point.y));
+
+    if (x < 0 || y < 0 || x >= m_Width || y >= m_Height) {
+        return std::nullopt;
+    }
+
+    return y * m_Width + x;
+}
+
+std::optional<std::pair<int32_t, float>> scbot::PathingGrid::Search(int32_t start) const
+{
+    static constexpr int32_t OffsetX[] = {1, -1, 0, 0, 1, 1, -1, -1};
+    static constexpr int32_t OffsetY[] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+    Push(start, 0.0f);
+
+    while (!m_Open.empty()) {
+        const auto node = Pop();
+        const auto cell = node.cell;
+
+        if (m_Closed[cell] == m_CurrentGeneration) {
+            continue;
+        }
+
+        m_Closed[cell] = m_CurrentGeneration;
+
+        const float cost = m_Cost[cell];
+
+        if (m_Goal[cell] == m_CurrentGeneration) {
+            return std::make_pair(cell, cost);
+        }
+
+        const int32_t x = cell % m_Width;
+        const int32_t y = cell / m_Width;
+
+        for (int32_t i = 0; i < 8; ++i) {
+            const int32_t nx = x + OffsetX[i];
+            const int32_t ny = y + OffsetY[i];
+
+            if (!IsPathable(nx, ny)) {
+                continue;
+            }
+
+            const bool diagonal = i >= 4;
+
+            // Units cannot squeeze between two blocked cells that only touch at a corner
+            if (diagonal && (!IsPathable(nx, y) || !IsPathable(x, ny))) {
+                continue;
+            }
+
+            const int32_t next = ny * m_Width + nx;
+            const float next_cost = cost + (diagonal ? DiagonalCost : 1.0f);
+
+            if (m_Closed[next] == m_CurrentGeneration ||
+                (m_Generation[next] == m_CurrentGeneration && m_Cost[next] <= next_cost)) {
+                continue;
+            }
+
+            Push(next, next_cost);
+        }
+    }
+
+    return std::nullopt;
+}
+
+void scbot::PathingGrid::Reset() const
+{
+    m_Open.clear();
+
+    // On wrap around stale stamps could look current, so they are cleared once every 2^32 searches
+    if (++m_CurrentGeneration == 0) {
+        std::fill(m_Generation.begin(), m_Generation.end(), 0);
+        std::fill(m_Closed.begin(), m_Closed.end(), 0);
+        std::fill(m_Goal.begin(), m_Goal.end(), 0);
+        m_CurrentGeneration = 1;
+    }
+}
+
+void scbot::PathingGrid::Push(int32_t cell, float cost) const
+{
+    m_Cost[cell] = cost;
+    m_Generation[cell] = m_CurrentGeneration;
+
+    m_Open.push_back({cost, cell});
+    std::push_heap(m_Open.begin(), m_Open.end(), Later);
+}
+
+scbot::PathingGrid::Node scbot::PathingGrid::Pop() const
+{
+    std::pop_heap(m_Open.begin(), m_Open.end(), Later);
+
+    const auto node = m_Open.back();
+    m_Open.pop_back();
+
+    return node;
+}
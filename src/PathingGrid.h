@@ -0,0 +1,126 @@
+#pragma once
+
+#include <sc2api/sc2_interfaces.h>
+#include <sc2api/sc2_unit.h>
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace scbot
+{
+
+/**
+ * @brief Local copy of where ground units can walk, so that travel distances do not need a query to the game.
+ *
+ * The grid starts from the pathing grid of the map and the footprints of our own structures are laid over it as
+ * they are created and destroyed. Distances are searched on the cells, with diagonal steps that do not cut corners,
+ * so they are close to but not exactly what the game would answer.
+ */
+class PathingGrid
+{
+public:
+    /**
+     * @brief Construct a new PathingGrid object for the map of the game, with our structures that are already on it.
+     *
+     * @param observation The observation of the game
+     */
+    PathingGrid(const sc2::ObservationInterface* observation);
+
+    /**
+     * @brief Destroy the PathingGrid object
+     */
+    ~PathingGrid();
+
+    /**
+     * @brief Block the footprint of one of our structures, nothing happens for other units or ones already added.
+     *
+     * @param unit The unit
+     */
+    void AddUnit(const sc2::Unit* unit);
+
+    /**
+     * @brief Free the footprint of a structure that has been added.
+     *
+     * @param unit The unit
+     */
+    void RemoveUnit(const sc2::Unit* unit);
+
+    /**
+     * @brief Check if a single cell can be walked on.
+     *
+     * @param x The column of the cell
+     * @param y The row of the cell
+     * @return true if the terrain is pathable and no structure covers the cell, false otherwise
+     */
+    bool IsPathable(int32_t x, int32_t y) const;
+
+    /**
+     * @brief Find the goal that is closest to a point by ground, with a single Dijkstra search for all of them.
+     *
+     * @param start The start of the paths
+     * @param goals The goals
+     * @return The index of the closest goal and the length of the path to it, or std::nullopt if no goal is reachable
+     */
+    std::optional<std::pair<size_t, float>> ClosestGoal(const sc2::Point2D& start, const std::vector<sc2::Point2D>& goals) const;
+
+private:
+    // Cells covered by a structure, kept so that removing it undoes exactly what adding it did
+    struct Footprint {
+        int32_t x;
+        int32_t y;
+        int32_t size;
+    };
+
+    struct Node {
+        float cost;
+        int32_t cell;
+    };
+
+    bool GetFootprint(const sc2::Unit* unit, Footprint& footprint) const;
+
+    void Apply(const Footprint& footprint, int32_t delta);
+
+    std::optional<int32_t> GetCell(const sc2::Point2D& point) const;
+
+    // Searches from a cell until the first cell marked as a goal, and returns that cell with the length of the path
+    std::optional<std::pair<int32_t, float>> Search(int32_t start) const;
+
+    // Starts a new search, the scratch state of earlier searches is invalidated by the generation
+    void Reset() const;
+
+    void Push(int32_t cell, float cost) const;
+
+    Node Pop() const;
+
+    const sc2::ObservationInterface* m_Observation;
+
+    int32_t m_Width;
+
+    int32_t m_Height;
+
+    // Pathable by terrain, one byte per cell in rows from the bottom of the map
+    std::vector<uint8_t> m_Terrain;
+
+    // Number of structures covering each cell
+    std::vector<uint8_t> m_Blocked;
+
+    std::unordered_map<sc2::Tag, Footprint> m_Footprints;
+
+    // Scratch state of the searches, kept between them so that a search does not allocate
+    mutable std::vector<float> m_Cost;
+
+    mutable std::vector<uint32_t> m_Generation;
+
+    mutable std::vector<uint32_t> m_Closed;
+
+    mutable std::vector<uint32_t> m_Goal;
+
+    mutable std::vector<Node> m_Open;
+
+    mutable uint32_t m_CurrentGeneration;
+};
+
+}
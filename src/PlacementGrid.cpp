@@ -0,0 +1,260 @@
+#include "PlacementGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Config.h"
+#include "Utilities.h"
+
+scbot::PlacementGrid::PlacementGrid(const sc2::ObservationInterface* observation)
+{
+    NON_NULL(observation);
+
+    m_Observation = observation;
+
+    const auto& game_info = observation->GetGameInfo();
+    m_Width = game_info.width;
+    m_Height = game_info.height;
+
+    const size_t cells = static_cast<size_t>(m_Width) * static_cast<size_t>(m_Height);
+    m_Terrain.assign(cells, 0);
+    m_Blocked.assign(cells, 0);
+    m_Reserved.assign(cells, 0);
+
+    // Sampled through the observation so that the bit packing and orientation of the placement grid stay its concern
+    for (int32_t y = 0; y < m_Height; ++y) {
+        for (int32_t x = 0; x < m_Width; ++x) {
+            m_Terrain[y * m_Width + x] = observation->IsPlacable(sc2::Point2D(x + 0.5f, y + 0.5f)) ? 1 : 0;
+        }
+    }
+
+    for (const auto* unit : observation->GetUnits()) {
+        AddUnit(unit);
+    }
+}
+
+scbot::PlacementGrid::~PlacementGrid()
+{
+}
+
+void scbot::PlacementGrid::AddUnit(const sc2::Unit* unit)
+{
+    NON_NULL(unit);
+
+    if (m_Footprints.find(unit->tag) != m_Footprints.end()) {
+        return;
+    }
+
+    Footprint footprint;
+    if (!GetFootprint(unit, footprint)) {
+        return;
+    }
+
+    m_Footprints.emplace(unit->tag, footprint);
+    Apply(footprint, 1);
+}
+
+void scbot::PlacementGrid::RemoveUnit(const sc2::Unit* unit)
+{
+    NON_NULL(unit);
+
+    const auto it = m_Footprints.find(unit->tag);
+
+    if (it == m_Footprints.end()) {
+        return;
+    }
+
+    Apply(it->second, -1);
+    m_Footprints.erase(it);
+}
+
+void scbot::PlacementGrid::Reject(sc2::ABILITY_ID ability_id, const sc2::Point2D& point, uint32_t expiry)
+{
+    Footprint footprint;
+    if (!GetFootprint(ability_id, point, footprint)) {
+        return;
+    }
+
+    m_Rejections.push_back({footprint, expiry});
+    Apply(footprint, 1);
+}
+
+void scbot::PlacementGrid::Confirm(sc2::ABILITY_ID ability_id, const sc2::Point2D& point)
+{
+    Footprint footprint;
+    if (!GetFootprint(ability_id, point, footprint)) {
+        return;
+    }
+
+    // The game checks the same units, anything in the grid that covers the spot is stale
+    for (auto it = m_Footprints.begin(); it != m_Footprints.end();) {
+        if (!Overlaps(it->second, footprint)) {
+            ++it;
+            continue;
+        }
+
+        Apply(it->second, -1);
+        it = m_Footprints.erase(it);
+    }
+
+    const auto stale = std::remove_if(m_Rejections.begin(), m_Rejections.end(), [this, &footprint](const Rejection& rejection) {
+        if (!Overlaps(rejection.footprint, footprint)) {
+            return false;
+        }
+
+        Apply(rejection.footprint, -1);
+        return true;
+    });
+
+    m_Rejections.erase(stale, m_Rejections.end());
+}
+
+void scbot::PlacementGrid::RemoveMissingUnits()
+{
+    for (auto it = m_Footprints.begin(); it != m_Footprints.end();) {
+        const auto* unit = m_Observation->GetUnit(it->first);
+
+        // The snapshot of a structure that died in the fog stays until the area is seen again
+        const bool missing = unit == nullptr || unit->is_flying ||
+            (unit->display_type == sc2::Unit::DisplayType::Snapshot && m_Observation->GetVisibility(unit->pos) == sc2::Visibility::Visible);
+
+        if (!missing) {
+            ++it;
+            continue;
+        }
+
+        Apply(it->second, -1);
+        it = m_Footprints.erase(it);
+    }
+}
+
+void scbot::PlacementGrid::ExpireRejections(uint32_t game_loop)
+{
+    const auto expired = std::remove_if(m_Rejections.begin(), m_Rejections.end(), [this, game_loop](const Rejection& rejection) {
+        if (rejection.expiry > game_loop) {
+            return false;
+        }
+
+        Apply(rejection.footprint, -1);
+        return true;
+    });
+
+    m_Rejections.erase(expired, m_Rejections.end());
+}
+
+bool scbot::PlacementGrid::CanPlace(sc2::ABILITY_ID ability_id, const sc2::Point2D& point) const
+{
+    Footprint footprint;
+    if (!GetFootprint(ability_id, point, footprint)) {
+        return false;
+    }
+
+    for (int32_t y = footprint.y; y < footprint.y + footprint.height; ++y) {
+        for (int32_t x = footprint.x; x < footprint.x + footprint.width; ++x) {
+            if (!IsFree(x, y)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool scbot::PlacementGrid::IsFree(int32_t x, int32_t y) const
+{
+    if (x < 0 || y < 0 || x >= m_Width || y >= m_Height) {
+        return false;
+    }
+
+    const size_t index = static_cast<size_t>(y) * m_Width + x;
+
+    return m_Terrain[index] != 0 && m_Blocked[index] == 0 && m_Reserved[index] == 0;
+}
+
+bool scbot::PlacementGrid::GetFootprint(const sc2::Unit* unit, Footprint& footprint) const
+{
+    if (unit->is_flying) {
+        return false;
+    }
+
+    footprint.resource = Utilities::IsMineralField(unit) || Utilities::IsVespeneGeyser(unit);
+
+    if (Utilities::IsMineralField(unit)) {
+        // Mineral fields are the only footprint that is not square
+        footprint.width = 2;
+        footprint.height = 1;
+    } else {
+        const auto& unit_types = m_Observation->GetUnitTypeData();
+        const auto index = static_cast<size_t>(static_cast<uint32_t>(unit->unit_type));
+
+        if (!footprint.resource) {
+            if (index >= unit_types.size()) {
+                return false;
+            }
+
+            const auto& attributes = unit_types[index].attributes;
+
+            if (std::find(attributes.begin(), attributes.end(), sc2::Attribute::Structure) == attributes.end()) {
+                return false;
+            }
+        }
+
+        // The radius of a structure is a bit larger than half its footprint, 1.125 for 2x2, 1.8125 for 3x3 and
+        // 2.75 for 5x5
+        footprint.width = std::max(static_cast<int32_t>(std::floor(unit->radius * 2.0f - 0.25f)), 1);
+        footprint.height = footprint.width;
+    }
+
+    footprint.x = static_cast<int32_t>(std::lround(unit->pos.x - footprint.width * 0.5f));
+    footprint.y = static_cast<int32_t>(std::lround(unit->pos.y - footprint.height * 0.5f));
+
+    return true;
+}
+
+bool scbot::PlacementGrid::GetFootprint(sc2::ABILITY_ID ability_id, const sc2::Point2D& point, Footprint& footprint) const
+{
+    const auto& abilities = m_Observation->GetAbilityData();
+    const auto index = static_cast<size_t>(static_cast<uint32_t>(ability_id));
+
+    if (index >= abilities.size() || abilities[index].footprint_radius <= 0.0f) {
+        return false;
+    }
+
+    // A footprint of even size is centred on a grid corner, one of odd size on the centre of a cell
+    const float radius = abilities[index].footprint_radius;
+    footprint.width = static_cast<int32_t>(std::lround(radius * 2.0f));
+    footprint.height = footprint.width;
+    footprint.x = static_cast<int32_t>(std::lround(point.x - radius));
+    footprint.y = static_cast<int32_t>(std::lround(point.y - radius));
+    footprint.resource = false;
+
+    return true;
+}
+
+void scbot::PlacementGrid::Apply(const Footprint& footprint, int32_t delta)
+{
+    const int32_t margin = footprint.resource ? PLACEMENT_RESOURCE_MARGIN : 0;
+
+    for (int32_t y = footprint.y - margin; y < footprint.y + footprint.height + margin; ++y) {
+        for (int32_t x = footprint.x - margin; x < footprint.x + footprint.width + margin; ++x) {
+            if (x < 0 || y < 0 || x >= m_Width || y >= m_Height) {
+                continue;
+            }
+
+            const size_t index = static_cast<size_t>(y) * m_Width + x;
+
+            const bool inside = x >= footprint.x && x < footprint.x + footprint.width &&
+                y >= footprint.y && y < footprint.y + footprint.height;
+
+            // The resource itself is blocked, the cells around it only reserved
+            auto& cell = inside ? m_Blocked[index] : m_Reserved[index];
+            cell = static_cast<uint8_t>(cell + delta);
+        }
+    }
+}
+
+bool scbot::PlacementGrid::Overlaps(const Footprint& lhs, const Footprint& rhs)
+{
+    return lhs.x < rhs.x + rhs.width && rhs.x < lhs.x + lhs.width &&
+        lhs.y < rhs.y + rhs.height && rhs.y < lhs.y + lhs.height;
+}
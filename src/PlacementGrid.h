@@ -0,0 +1,145 @@
+#pragma once
+
+#include <sc2api/sc2_interfaces.h>
+#include <sc2api/sc2_unit.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace scbot
+{
+
+/**
+ * @brief Local copy of where structures can be placed, so that placement does not need a query per candidate.
+ *
+ * The grid starts from the placement grid of the map and is kept up to date with the footprints of the structures
+ * that are seen being created and destroyed. Cells close to minerals and geysers are reserved, so that nothing is
+ * built in the mineral lines and town halls keep the distance to resources that the game enforces.
+ *
+ * Power and units standing in the way are not modelled, the caller confirms the chosen spot with the game and
+ * rejects it in the grid for a while if the game disagrees, or frees it if the game allows it. Footprints of units
+ * that disappeared without an event are dropped when they are checked against the observation.
+ */
+class PlacementGrid
+{
+public:
+    /**
+     * @brief Construct a new PlacementGrid object for the map of the game, with the units that are already on it.
+     *
+     * @param observation The observation of the game
+     */
+    PlacementGrid(const sc2::ObservationInterface* observation);
+
+    /**
+     * @brief Destroy the PlacementGrid object
+     */
+    ~PlacementGrid();
+
+    /**
+     * @brief Block the footprint of a unit, nothing happens for units without one or that are already added.
+     *
+     * @param unit The unit
+     */
+    void AddUnit(const sc2::Unit* unit);
+
+    /**
+     * @brief Free the footprint of a unit that has been added.
+     *
+     * @param unit The unit
+     */
+    void RemoveUnit(const sc2::Unit* unit);
+
+    /**
+     * @brief Block the footprint of a structure for a while after the game refused to place it there.
+     *
+     * @param ability_id The ability that builds the structure
+     * @param point The center of the structure
+     * @param expiry The game loop after which the spot is free again
+     */
+    void Reject(sc2::ABILITY_ID ability_id, const sc2::Point2D& point, uint32_t expiry);
+
+    /**
+     * @brief Free the footprints and rejections covering a spot that the game has confirmed to be placeable.
+     *
+     * @param ability_id The ability that builds the structure
+     * @param point The center of the structure
+     */
+    void Confirm(sc2::ABILITY_ID ability_id, const sc2::Point2D& point);
+
+    /**
+     * @brief Free the footprints of units that are gone, lifted off, or only a snapshot in an area that is visible.
+     *
+     * Structures that die out of vision do not send an event, their footprint stays until this is called.
+     */
+    void RemoveMissingUnits();
+
+    /**
+     * @brief Free the spots of rejections that have expired.
+     *
+     * @param game_loop The current game loop
+     */
+    void ExpireRejections(uint32_t game_loop);
+
+    /**
+     * @brief Check if a structure could be placed.
+     *
+     * @param ability_id The ability that builds the structure
+     * @param point The center of the structure
+     * @return true if every cell of the footprint is free, false otherwise
+     */
+    bool CanPlace(sc2::ABILITY_ID ability_id, const sc2::Point2D& point) const;
+
+    /**
+     * @brief Check if a single cell is free for a structure.
+     *
+     * @param x The column of the cell
+     * @param y The row of the cell
+     * @return true if the terrain allows placement and no footprint or reservation covers the cell, false otherwise
+     */
+    bool IsFree(int32_t x, int32_t y) const;
+
+private:
+    // Cells covered by a unit, kept so that removing it undoes exactly what adding it did
+    struct Footprint {
+        int32_t x;
+        int32_t y;
+        int32_t width;
+        int32_t height;
+        bool resource;
+    };
+
+    struct Rejection {
+        Footprint footprint;
+        uint32_t expiry;
+    };
+
+    bool GetFootprint(const sc2::Unit* unit, Footprint& footprint) const;
+
+    bool GetFootprint(sc2::ABILITY_ID ability_id, const sc2::Point2D& point, Footprint& footprint) const;
+
+    void Apply(const Footprint& footprint, int32_t delta);
+
+    static bool Overlaps(const Footprint& lhs, const Footprint& rhs);
+
+    const sc2::ObservationInterface* m_Observation;
+
+    int32_t m_Width;
+
+    int32_t m_Height;
+
+    // Placeable by terrain, one byte per cell in rows from the bottom of the map
+    std::vector<uint8_t> m_Terrain;
+
+    // Number of footprints covering each cell, footprints of neighbouring units can overlap
+    std::vector<uint8_t> m_Blocked;
+
+    // Number of resources each cell is reserved for
+    std::vector<uint8_t> m_Reserved;
+
+    std::unordered_map<sc2::Tag, Footprint> m_Footprints;
+
+    std::vector<Rejection> m_Rejections;
+};
+
+}
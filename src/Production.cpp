@@ -105,6 +105,23 @@ std::optional<float> scbot::Production::TimeLeftForEconomicRequirements(const Pr
 }
 
 std::optional<sc2::Point2D> scbot::Production::IdealPositionForBuilding(sc2::ABILITY_ID ability_id)
+{
+    const auto position = SelectPositionForBuilding(ability_id);
+
+    // Nexus and assimilator spots come from the expansions and geysers, not from the placement grid
+    if (!position.has_value() || ability_id == sc2::ABILITY_ID::BUILD_NEXUS || ability_id == sc2::ABILITY_ID::BUILD_ASSIMILATOR) {
+        return position;
+    }
+
+    // The spot is only used once the game has allowed it, a refused spot is blocked and another one is chosen next time
+    if (!m_Collective->ConfirmPlacement(ability_id, position.value()).value_or(false)) {
+        return std::nullopt;
+    }
+
+    return position;
+}
+
+std::optional<sc2::Point2D> scbot::Production::SelectPositionForBuilding(sc2::ABILITY_ID ability_id)
 {
     switch (ability_id) {
     case sc2::ABILITY_ID::BUILD_NEXUS:
@@ -218,32 +235,10 @@ std::optional<const sc2::Unit*> scbot::Production::MoveProbeToPosition(Proletari
         return std::nullopt;
     }
 
-    const auto& [movePosition, moveDistance] = scbot::Map::GetBestPath(
-        m_Collective->Query(),
-        probe,
-        position,
-        distance,
-        distance + 1.0f
-    );
-
-    if (movePosition.x == 0.0f && movePosition.y == 0.0f) {
-        return probe;
-    }
-    
-    const auto& unit_data = m_Collective->Observation()->GetUnitTypeData();
-
-    const auto& movement_speed = unit_data.at(probe->unit_type).movement_speed;
-
-    const auto time_to_move = moveDistance / movement_speed;
-
-    if (time_to_move < max_time) {
+    if (!MoveProbeToPosition(probe, position, distance, max_time)) {
         return std::nullopt;
     }
 
-    auto* actions = m_Collective->Actions();
-
-    actions->UnitCommand(probe, sc2::ABILITY_ID::MOVE_MOVE, movePosition);
-
     return probe;
 }
 
@@ -252,7 +247,7 @@ bool scbot::Production::MoveProbeToPosition(const sc2::Unit* probe, const sc2::P
     NON_NULL(probe);
 
     const auto& [movePosition, moveDistance] = scbot::Map::GetBestPath(
-        m_Collective->Query(),
+        m_Collective->GetPathingGrid(),
         probe,
         position,
         distance,
@@ -342,7 +337,7 @@ std::optional<sc2::Point2D> scbot::Production::IdealPositionForPylon()
         
         for (const auto& probe : probes) {
             const auto result = Map::GetClosestPlace(
-                m_Collective->Query(),
+                m_Collective->GetPlacementGrid(),
                 probe->pos,
                 probe->pos,
                 sc2::ABILITY_ID::BUILD_PYLON,
@@ -366,7 +361,7 @@ std::optional<sc2::Point2D> scbot::Production::IdealPositionForPylon()
         const auto& closest_ramp = m_Collective->GetClosestRamp(closest_nexus->pos);
 
         auto result = scbot::Map::GetClosestPlace(
-            m_Collective->Query(),
+            m_Collective->GetPlacementGrid(),
             closest_ramp,
             closest_nexus->pos,
             sc2::ABILITY_ID::BUILD_PYLON,
@@ -376,7 +371,7 @@ std::optional<sc2::Point2D> scbot::Production::IdealPositionForPylon()
 
         if (result.x == 0.0f && result.y == 0.0f) {
             result = scbot::Map::GetClosestPlace(
-                m_Collective->Query(),
+                m_Collective->GetPlacementGrid(),
                 closest_ramp,
                 closest_nexus->pos,
                 sc2::ABILITY_ID::BUILD_PYLON,
@@ -399,7 +394,7 @@ std::optional<sc2::Point2D> scbot::Production::IdealPositionForPylon()
 
     if (!unpowered_structures.empty()) {
         const auto result = Map::GetBestCenter(
-            m_Collective->Query(),
+            m_Collective->GetPlacementGrid(),
             unpowered_structures,
             sc2::ABILITY_ID::BUILD_PYLON,
             3.0f,
@@ -421,7 +416,7 @@ std::optional<sc2::Point2D> scbot::Production::IdealPositionForPylon()
     sc2::Units avoid = Utilities::Union(pylons, mining_points);
 
     const auto result = Map::GetClosestPlaceWhileAvoiding(
-        m_Collective->Query(),
+        m_Collective->GetPlacementGrid(),
         fewest_pylons->pos,
         fewest_pylons->pos,
         avoid,
@@ -508,7 +503,7 @@ std::optional<sc2::Point2D> scbot::Production::IdealPositionForArbitrary2X2Build
 
         if (Utilities::AnyWithinRange(pylons, closest_ramp, 5.0f)) {
             auto result = Map::GetClosestPlace(
-                m_Collective->Query(),
+                m_Collective->GetPlacementGrid(),
                 closest_ramp,
                 closest_ramp,
                 pylons,
@@ -529,7 +524,7 @@ std::optional<sc2::Point2D> scbot::Production::IdealPositionForArbitrary2X2Build
         const auto& closest_nexus = Utilities::ClosestTo(nexuses, pylon->pos);
 
         const auto result = Map::GetClosestPlace(
-            m_Collective->Query(),
+            m_Collective->GetPlacementGrid(),
             pylon->pos,
             closest_nexus->pos,
             pylons,
@@ -56,6 +56,9 @@ public:
     /**
      * @brief Calculate the ideal position for a building.
      * 
+     * The position is chosen from the local placement grid and only returned once the game has allowed it, which
+     * takes until the queries of the step are flushed. A spot the game refuses is not chosen again for a while.
+     * 
      * @param ability_id The ability id
      * @return The position, or std::nullopt if no position is found
      */
@@ -87,18 +90,18 @@ public:
      * @param position The position
      * @param distance The distance to keep from the position
      * @param max_time The maximum time to spend moving the probe
-     * @return The probe, or std::nullopt if no probe is found or the probe needs to move too far
+     * @return The probe, or std::nullopt if no probe is found or the probe is close enough to wait
      */
     std::optional<const sc2::Unit*> MoveProbeToPosition(Proletariat& proletariat, const sc2::Point2D& position, float distance, float max_time);
 
     /**
-     * @brief Move a probe to a position for building.
+     * @brief Move a probe to a position for building, the path is found on the local pathing grid.
      * 
      * @param probe The probe
      * @param position The position
      * @param distance The distance to keep from the position
-     * @param max_time The maximum time to spend moving the probe
-     * @return true if the probe is at the position, false otherwise
+     * @param max_time The probe is only moved if the path takes at least this long
+     * @return true if the probe was moved or is at the position, false if it is close enough to wait
      */
     bool MoveProbeToPosition(const sc2::Unit* probe, const sc2::Point2D& position, float distance, float max_time);
 
@@ -122,6 +125,7 @@ public:
     ~Production();
 
 private:
+    std::optional<sc2::Point2D> SelectPositionForBuilding(sc2::ABILITY_ID ability_id);
     std::optional<sc2::Point2D> IdealPositionForNexus();
     std::optional<sc2::Point2D> IdealPositionForPylon();
     std::optional<sc2::Point2D> IdealPositionForGateway();
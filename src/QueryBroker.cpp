@@ -0,0 +1,63 @@
+#include "QueryBroker.h"
+
+#include "Config.h"
+
+scbot::QueryBroker::QueryBroker(sc2::QueryInterface* query)
+{
+    NON_NULL(query);
+
+    m_Query = query;
+}
+
+scbot::QueryBroker::~QueryBroker()
+{
+}
+
+void scbot::QueryBroker::Placement(const sc2::QueryInterface::PlacementQuery& query, PlacementContinuation continuation)
+{
+    const PlacementKey key {static_cast<uint32_t>(query.ability), query.target_pos.x, query.target_pos.y, query.placing_unit_tag};
+
+    const auto [it, inserted] = m_PlacementIndex.emplace(key, m_Placements.size());
+
+    if (inserted) {
+        m_Placements.push_back({query, {}});
+    }
+
+    m_Placements[it->second].continuations.push_back(std::move(continuation));
+}
+
+void scbot::QueryBroker::Flush()
+{
+    // Taken out first, continuations may register queries for the next flush
+    auto placements = std::move(m_Placements);
+
+    m_Placements.clear();
+    m_PlacementIndex.clear();
+
+    if (placements.empty()) {
+        return;
+    }
+
+    std::vector<sc2::QueryInterface::PlacementQuery> queries;
+    queries.reserve(placements.size());
+
+    for (const auto& pending : placements) {
+        queries.push_back(pending.query);
+    }
+
+    const auto results = m_Query->Placement(queries);
+
+    // A response that is short, for example when the game has ended, answers the missing queries negatively
+    for (size_t i = 0; i < placements.size(); ++i) {
+        const bool result = i < results.size() && results[i];
+
+        for (const auto& continuation : placements[i].continuations) {
+            continuation(result);
+        }
+    }
+}
+
+size_t scbot::QueryBroker::GetPendingCount() const
+{
+    return m_Placements.size();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <sc2api/sc2_interfaces.h>
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace scbot
+{
+
+/**
+ * @brief Collects the placement queries of a step and sends them to the game in one request.
+ *
+ * Every query to the game is a blocking round trip, so instead of asking right away callers register a query with
+ * a continuation. The queries are sent when the broker is flushed, once per step, and the continuations are called
+ * with the results in the order they were registered. Identical queries of the same step are sent once and their
+ * continuations share the result.
+ */
+class QueryBroker
+{
+public:
+    using PlacementContinuation = std::function<void(bool)>;
+
+    /**
+     * @brief Construct a new QueryBroker object
+     *
+     * @param query The query interface of the bot
+     */
+    QueryBroker(sc2::QueryInterface* query);
+
+    /**
+     * @brief Destroy the QueryBroker object, pending queries are dropped
+     */
+    ~QueryBroker();
+
+    /**
+     * @brief Register a placement query.
+     *
+     * @param query The query
+     * @param continuation Called with whether the structure can be placed
+     */
+    void Placement(const sc2::QueryInterface::PlacementQuery& query, PlacementContinuation continuation);
+
+    /**
+     * @brief Send the registered queries and call their continuations.
+     *
+     * Queries registered by the continuations are sent with the next flush.
+     */
+    void Flush();
+
+    /**
+     * @brief Get the number of distinct queries waiting for the next flush.
+     *
+     * @return The number of queries
+     */
+    size_t GetPendingCount() const;
+
+private:
+    // Queries are deduplicated on their exact fields
+    using PlacementKey = std::tuple<uint32_t, float, float, sc2::Tag>;
+
+    struct PendingPlacement {
+        sc2::QueryInterface::PlacementQuery query;
+        std::vector<PlacementContinuation> continuations;
+    };
+
+    sc2::QueryInterface* m_Query;
+
+    std::vector<PendingPlacement> m_Placements;
+
+    // Index of each distinct query in the pending list
+    std::map<PlacementKey, size_t> m_PlacementIndex;
+};
+
+}
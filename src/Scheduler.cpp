@@ -0,0 +1,47 @@
+#include "Scheduler.h"
+
+scbot::Scheduler::Scheduler()
+{
+}
+
+scbot::Scheduler::~Scheduler()
+{
+}
+
+void scbot::Scheduler::Spawn(Routine routine)
+{
+    if (!routine.Step()) {
+        m_Routines.push_back(std::move(routine));
+    }
+}
+
+void scbot::Scheduler::OnStep()
+{
+    // Routines spawned by a routine go straight into the list and are first resumed on the next step
+    auto routines = std::move(m_Routines);
+    m_Routines.clear();
+
+    for (size_t i = 0; i < routines.size(); ++i) {
+        bool finished;
+
+        try {
+            finished = routines[i].Step();
+        } catch (...) {
+            // The routines that were not resumed yet are kept, only the one that threw is dropped
+            for (size_t j = i + 1; j < routines.size(); ++j) {
+                m_Routines.push_back(std::move(routines[j]));
+            }
+
+            throw;
+        }
+
+        if (!finished) {
+            m_Routines.push_back(std::move(routines[i]));
+        }
+    }
+}
+
+size_t scbot::Scheduler::GetRoutineCount() const
+{
+    return m_Routines.size();
+}
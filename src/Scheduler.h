@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Generator.h"
+
+namespace scbot
+{
+
+/**
+ * @brief Runs routines on the game thread, each one is resumed once per step when what it awaits is ready.
+ *
+ * Long computations are submitted to the ThreadPool from a routine and awaited there, so the step that started
+ * them is not blocked and the routine continues on a later step with the result.
+ */
+class Scheduler
+{
+public:
+    /**
+     * @brief Construct a new Scheduler object
+     */
+    Scheduler();
+
+    /**
+     * @brief Destroy the Scheduler object, routines that have not finished are destroyed.
+     */
+    ~Scheduler();
+
+    /**
+     * @brief Start a routine, it runs until it awaits something that is not ready.
+     *
+     * @param routine The routine
+     */
+    void Spawn(Routine routine);
+
+    /**
+     * @brief Method that is called every frame, resumes the routines that can continue.
+     *
+     * @note Rethrows the exception of a routine that threw one, the routine is dropped
+     */
+    void OnStep();
+
+    /**
+     * @brief Get the number of routines that have not finished.
+     *
+     * @return The number of routines
+     */
+    size_t GetRoutineCount() const;
+
+private:
+    std::vector<Routine> m_Routines;
+};
+
+}
@@ -0,0 +1,125 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace {
+
+// The pool and queue of the worker running on this thread, so that nested submissions stay on it
+thread_local const scbot::ThreadPool* CurrentPool = nullptr;
+thread_local uint32_t CurrentWorker = 0;
+
+}
+
+scbot::ThreadPool::ThreadPool(uint32_t threads)
+{
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    m_Pending = 0;
+    m_Next = 0;
+    m_Shutdown = false;
+
+    for (uint32_t i = 0; i < threads; ++i) {
+        m_Queues.push_back(std::make_unique<Queue>());
+    }
+
+    for (uint32_t i = 0; i < threads; ++i) {
+        m_Threads.emplace_back(&ThreadPool::Worker, this, i);
+    }
+}
+
+scbot::ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock lock(m_Mutex);
+        m_Shutdown = true;
+    }
+
+    m_Condition.notify_all();
+
+    for (auto& thread : m_Threads) {
+        thread.join();
+    }
+}
+
+uint32_t scbot::ThreadPool::GetThreadCount() const
+{
+    return static_cast<uint32_t>(m_Threads.size());
+}
+
+void scbot::ThreadPool::Push(Job job)
+{
+    const uint32_t index = CurrentPool == this ?
+        CurrentWorker :
+        m_Next.fetch_add(1, std::memory_order_relaxed) % static_cast<uint32_t>(m_Queues.size());
+
+    // Counted and queued under the sleep lock, so that a worker woken by the count always finds the job and cannot
+    // check for work and fall asleep in between. Counted first so that a pop never takes the count below zero.
+    {
+        std::unique_lock lock(m_Mutex);
+        m_Pending.fetch_add(1, std::memory_order_release);
+
+        std::unique_lock queue_lock(m_Queues[index]->mutex);
+        m_Queues[index]->jobs.push_back(std::move(job));
+    }
+
+    m_Condition.notify_one();
+}
+
+bool scbot::ThreadPool::Pop(uint32_t id, Job& job)
+{
+    // Newest job of the own queue first
+    {
+        auto& queue = *m_Queues[id];
+        std::unique_lock lock(queue.mutex);
+
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            m_Pending.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Then the oldest job of any other queue
+    for (size_t offset = 1; offset < m_Queues.size(); ++offset) {
+        auto& queue = *m_Queues[(id + offset) % m_Queues.size()];
+        std::unique_lock lock(queue.mutex);
+
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            m_Pending.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void scbot::ThreadPool::Worker(uint32_t id)
+{
+    CurrentPool = this;
+    CurrentWorker = id;
+
+    while (true) {
+        Job job;
+
+        if (Pop(id, job)) {
+            job();
+            continue;
+        }
+
+        std::unique_lock lock(m_Mutex);
+
+        // Queued jobs are finished before shutting down, futures of submitted tasks always complete
+        m_Condition.wait(lock, [this]() {
+            return m_Shutdown || m_Pending.load(std::memory_order_acquire) != 0;
+        });
+
+        if (m_Shutdown && m_Pending.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace scbot
+{
+
+/**
+ * @brief Result of a task, shared between the thread that runs it and the threads that wait for it.
+ */
+template<typename T>
+struct FutureState {
+    // void results are stored as an empty value so that the state does not need a specialisation
+    using Storage = std::conditional_t<std::is_void_v<T>, bool, T>;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::atomic<bool> ready = false;
+    std::optional<Storage> value;
+    std::exception_ptr exception;
+};
+
+/**
+ * @brief Handle to the result of a task submitted to a ThreadPool.
+ *
+ * Futures are cheap to copy, all copies refer to the same result. Inside a Routine a future can be awaited with
+ * co_await, which suspends the routine until the result is ready instead of blocking the game thread.
+ */
+template<typename T>
+class Future
+{
+public:
+    Future() = default;
+
+    Future(std::shared_ptr<FutureState<T>> state) : m_State(std::move(state)) {}
+
+    /**
+     * @brief Check if the task has finished, never blocks.
+     *
+     * @return true if the result is available, false otherwise
+     */
+    bool IsReady() const
+    {
+        return m_State != nullptr && m_State->ready.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Block until the task has finished.
+     */
+    void Wait() const
+    {
+        std::unique_lock lock(m_State->mutex);
+        m_State->condition.wait(lock, [this]() { return m_State->ready.load(std::memory_order_acquire); });
+    }
+
+    /**
+     * @brief Block until the task has finished and get its result.
+     *
+     * @note Rethrows the exception of the task if it threw one
+     * @return The result of the task
+     */
+    T Get() const
+    {
+        Wait();
+
+        if (m_State->exception) {
+            std::rethrow_exception(m_State->exception);
+        }
+
+        if constexpr (!std::is_void_v<T>) {
+            return *m_State->value;
+        }
+    }
+
+private:
+    std::shared_ptr<FutureState<T>> m_State;
+};
+
+/**
+ * @brief Fixed set of worker threads for background work of the whole bot.
+ *
+ * Every worker owns a queue. Tasks submitted from a worker go to the back of its own queue and are taken from
+ * the back again, so nested work stays on the thread that has its data in cache. Tasks submitted from other
+ * threads are spread over the queues. An idle worker steals from the front of the other queues before it sleeps.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief Construct a new ThreadPool object and start its workers.
+     *
+     * @param threads The number of workers, 0 to use all but one hardware thread
+     */
+    ThreadPool(uint32_t threads);
+
+    /**
+     * @brief Destroy the ThreadPool object, the tasks that are still queued are run before the workers stop.
+     */
+    ~ThreadPool();
+
+    /**
+     * @brief Queue a function to be run by a worker.
+     *
+     * @param function The function, called without arguments
+     * @return A future with the result of the function
+     */
+    template<typename F>
+    auto Submit(F&& function) -> Future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+
+        auto state = std::make_shared<FutureState<Result>>();
+
+        Push([state, function = std::forward<F>(function)]() mutable {
+            try {
+                if constexpr (std::is_void_v<Result>) {
+                    function();
+                    state->value.emplace(true);
+                } else {
+                    state->value.emplace(function());
+                }
+            } catch (...) {
+                state->exception = std::current_exception();
+            }
+
+            {
+                std::unique_lock lock(state->mutex);
+                state->ready.store(true, std::memory_order_release);
+            }
+
+            state->condition.notify_all();
+        });
+
+        return Future<Result>(std::move(state));
+    }
+
+    /**
+     * @brief Get the number of workers.
+     *
+     * @return The number of workers
+     */
+    uint32_t GetThreadCount() const;
+
+private:
+    using Job = std::function<void()>;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void Push(Job job);
+
+    bool Pop(uint32_t id, Job& job);
+
+    void Worker(uint32_t id);
+
+    std::vector<std::unique_ptr<Queue>> m_Queues;
+
+    std::vector<std::thread> m_Threads;
+
+    // Guards sleeping and waking the workers, the queues have their own locks
+    std::mutex m_Mutex;
+
+    std::condition_variable m_Condition;
+
+    // Jobs that have been pushed but not yet taken
+    std::atomic<size_t> m_Pending;
+
+    // Queue that the next job from outside the pool goes to
+    std::atomic<uint32_t> m_Next;
+
+    bool m_Shutdown;
+};
+
+}
@@ -0,0 +1,201 @@
+#include "TranspositionTable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr uint8_t GenerationMask = 0x3F;
+
+constexpr uint64_t DepthShift = 48;
+constexpr uint64_t MoveShift = 32;
+constexpr uint64_t BoundShift = 56;
+constexpr uint64_t GenerationShift = 58;
+
+// Scores are stored as fixed point with this many steps per unit. The evaluation is a sum of multiples of 0.5, so
+// every score the search produces is stored exactly, up to ScoreLimit / ScoreScale.
+constexpr double ScoreScale = 256.0;
+
+// Stored for an infinite score, finite scores beyond it saturate to it
+constexpr int32_t ScoreLimit = std::numeric_limits<int32_t>::max();
+
+}
+
+scbot::TranspositionTable::TranspositionTable(size_t megabytes)
+{
+    m_Generation = 0;
+
+    Resize(megabytes);
+}
+
+scbot::TranspositionTable::~TranspositionTable()
+{
+}
+
+void scbot::TranspositionTable::Resize(size_t megabytes)
+{
+    const size_t budget = std::max<size_t>(megabytes, 1) * 1024 * 1024;
+
+    // Round down to a power of two so a bucket can be selected with a mask.
+    size_t count = 1;
+    while (count * 2 * sizeof(Bucket) <= budget) {
+        count *= 2;
+    }
+
+    m_Buckets = std::make_unique<Bucket[]>(count);
+    m_BucketCount = count;
+    m_Mask = count - 1;
+
+    Clear();
+}
+
+void scbot::TranspositionTable::Clear()
+{
+    for (size_t i = 0; i < m_BucketCount; ++i) {
+        for (auto& slot : m_Buckets[i].slots) {
+            slot.key.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void scbot::TranspositionTable::NewSearch()
+{
+    m_Generation = (m_Generation + 1) & GenerationMask;
+}
+
+bool scbot::TranspositionTable::Probe(uint64_t key, TranspositionEntry& entry) const
+{
+    const auto& bucket = GetBucket(key);
+
+    for (const auto& slot : bucket.slots) {
+        const auto data = slot.data.load(std::memory_order_relaxed);
+
+        if (data == 0 || (slot.key.load(std::memory_order_relaxed) ^ data) != key) {
+            continue;
+        }
+
+        entry = Unpack(data);
+
+        return entry.bound != Bound::None;
+    }
+
+    return false;
+}
+
+void scbot::TranspositionTable::Store(uint64_t key, double score, int32_t depth, Bound bound, uint16_t move)
+{
+    auto& bucket = GetBucket(key);
+
+    Slot* replace = nullptr;
+    bool replace_empty = false;
+    int32_t replace_value = 0;
+
+    for (auto& slot : bucket.slots) {
+        const auto data = slot.data.load(std::memory_order_relaxed);
+
+        if (data == 0) {
+            if (!replace_empty) {
+                replace = &slot;
+                replace_empty = true;
+            }
+            continue;
+        }
+
+        if ((slot.key.load(std::memory_order_relaxed) ^ data) == key) {
+            const auto existing = Unpack(data);
+
+            // Keep deeper results of the current search unless the new one is exact.
+            if (bound != Bound::Exact && GetGeneration(data) == m_Generation && depth < existing.depth - 2) {
+                return;
+            }
+
+            // Keep the old best move if the new result has none, it is still the best guess.
+            if (move == NoMove) {
+                move = existing.move;
+            }
+
+            replace = &slot;
+            break;
+        }
+
+        if (replace_empty) {
+            continue;
+        }
+
+        // Prefer replacing shallow entries and entries from previous searches.
+        const int32_t age = (m_Generation - GetGeneration(data)) & GenerationMask;
+        const int32_t value = Unpack(data).depth - age * 8;
+
+        if (replace == nullptr || value < replace_value) {
+            replace = &slot;
+            replace_value = value;
+        }
+    }
+
+    const auto data = Pack(score, depth, bound, m_Generation, move);
+
+    replace->key.store(key ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+}
+
+size_t scbot::TranspositionTable::GetCapacity() const
+{
+    return m_BucketCount * BucketSize;
+}
+
+uint64_t scbot::TranspositionTable::Pack(double score, int32_t depth, Bound bound, uint8_t generation, uint16_t move)
+{
+    // A score between two steps is rounded the way that keeps a bound a bound, only exact scores go to the nearest
+    double scaled = score * ScoreScale;
+
+    if (bound == Bound::Upper) {
+        scaled = std::ceil(scaled);
+    } else if (bound == Bound::Lower) {
+        scaled = std::floor(scaled);
+    } else {
+        scaled = std::round(scaled);
+    }
+
+    const auto compact_score = static_cast<int32_t>(std::clamp(scaled, -static_cast<double>(ScoreLimit), static_cast<double>(ScoreLimit)));
+    const auto score_bits = static_cast<uint32_t>(compact_score);
+
+    const auto compact_depth = static_cast<uint8_t>(std::clamp(depth, 0, 255));
+
+    return static_cast<uint64_t>(score_bits) |
+        (static_cast<uint64_t>(move) << MoveShift) |
+        (static_cast<uint64_t>(compact_depth) << DepthShift) |
+        (static_cast<uint64_t>(bound) << BoundShift) |
+        (static_cast<uint64_t>(generation & GenerationMask) << GenerationShift);
+}
+
+scbot::TranspositionEntry scbot::TranspositionTable::Unpack(uint64_t data)
+{
+    const auto compact_score = static_cast<int32_t>(static_cast<uint32_t>(data & 0xFFFFFFFF));
+
+    TranspositionEntry entry;
+    entry.score = compact_score == ScoreLimit ? INFINITY :
+        compact_score == -ScoreLimit ? -INFINITY :
+        compact_score / ScoreScale;
+    entry.move = static_cast<uint16_t>((data >> MoveShift) & 0xFFFF);
+    entry.depth = static_cast<int32_t>((data >> DepthShift) & 0xFF);
+    entry.bound = static_cast<Bound>((data >> BoundShift) & 0x3);
+
+    return entry;
+}
+
+uint8_t scbot::TranspositionTable::GetGeneration(uint64_t data)
+{
+    return static_cast<uint8_t>((data >> GenerationShift) & GenerationMask);
+}
+
+scbot::TranspositionTable::Bucket& scbot::TranspositionTable::GetBucket(uint64_t key)
+{
+    return m_Buckets[key & m_Mask];
+}
+
+const scbot::TranspositionTable::Bucket& scbot::TranspositionTable::GetBucket(uint64_t key) const
+{
+    return m_Buckets[key & m_Mask];
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace scbot
+{
+
+/**
+ * @brief How the score of a transposition entry relates to the true score of the position.
+ */
+enum class Bound : uint8_t {
+    None = 0,
+    Upper = 1,
+    Lower = 2,
+    Exact = 3
+};
+
+/**
+ * @brief A decoded entry of the transposition table.
+ */
+struct TranspositionEntry {
+    double score;
+    int32_t depth;
+    Bound bound;
+    uint16_t move;
+};
+
+/**
+ * @brief Fixed-size transposition table for the macro search.
+ *
+ * The table is a power-of-two array of cache-line sized buckets, each holding a few entries.
+ * Entries store a compact best move instead of the full move sequence, and the score in 32-bit fixed
+ * point, which holds every score of the evaluation exactly. When a bucket is full the entry with the
+ * lowest depth, adjusted for how many searches ago it was written, is replaced.
+ *
+ * The table is shared by all search threads without locking. Each slot stores its key xor'ed with
+ * its data, so a slot torn by concurrent writes fails verification and is treated as a miss.
+ */
+class TranspositionTable
+{
+public:
+    // Best move value for entries that do not have one.
+    static constexpr uint16_t NoMove = 0xFFFF;
+
+    /**
+     * @brief Construct a new TranspositionTable object
+     *
+     * @param megabytes The memory budget of the table
+     */
+    TranspositionTable(size_t megabytes);
+
+    /**
+     * @brief Destroy the TranspositionTable object
+     */
+    ~TranspositionTable();
+
+    /**
+     * @brief Reallocate the table to fit a new memory budget, clearing all entries.
+     *
+     * @param megabytes The memory budget of the table
+     */
+    void Resize(size_t megabytes);
+
+    /**
+     * @brief Remove all entries.
+     */
+    void Clear();
+
+    /**
+     * @brief Mark the start of a new search, entries from older searches are replaced first.
+     */
+    void NewSearch();
+
+    /**
+     * @brief Look up a position.
+     *
+     * @param key The hash of the position
+     * @param entry The entry, if found
+     * @return true if the position was found, false otherwise
+     */
+    bool Probe(uint64_t key, TranspositionEntry& entry) const;
+
+    /**
+     * @brief Store a position.
+     *
+     * @param key The hash of the position
+     * @param score The score of the position
+     * @param depth The depth the position was searched to
+     * @param bound How the score relates to the true score
+     * @param move The best move, or NoMove
+     */
+    void Store(uint64_t key, double score, int32_t depth, Bound bound, uint16_t move);
+
+    /**
+     * @brief Get the number of entries the table can hold.
+     *
+     * @return The capacity of the table
+     */
+    size_t GetCapacity() const;
+
+private:
+    static constexpr size_t BucketSize = 4;
+
+    struct Slot {
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> data;
+    };
+
+    struct alignas(64) Bucket {
+        Slot slots[BucketSize];
+    };
+
+    static uint64_t Pack(double score, int32_t depth, Bound bound, uint8_t generation, uint16_t move);
+
+    static TranspositionEntry Unpack(uint64_t data);
+
+    static uint8_t GetGeneration(uint64_t data);
+
+    Bucket& GetBucket(uint64_t key);
+
+    const Bucket& GetBucket(uint64_t key) const;
+
+    std::unique_ptr<Bucket[]> m_Buckets;
+
+    size_t m_BucketCount;
+
+    uint64_t m_Mask;
+
+    uint8_t m_Generation;
+};
+
+}
@@ -1,5 +1,8 @@
 #include "Utilities.h"
 
+#include <fstream>
+#include <sstream>
+
 #include "Data.h"
 #include "Config.h"
 
@@ -263,6 +266,64 @@ float scbot::Utilities::ToGameTimeFromSeconds(float time) {
     return time * 22.4f;
 }
 
+bool scbot::Utilities::WriteUnitTypes(const std::string& path, const sc2::UnitTypes& unit_types) {
+    std::ofstream file(path);
+
+    if (!file) {
+        return false;
+    }
+
+    file << "# unit_type_id build_time name" << std::endl;
+
+    for (const auto& unit_type : unit_types) {
+        if (unit_type.name.empty()) {
+            continue;
+        }
+
+        file << static_cast<uint32_t>(unit_type.unit_type_id) << " " << unit_type.build_time << " " << unit_type.name << std::endl;
+    }
+
+    return static_cast<bool>(file);
+}
+
+bool scbot::Utilities::ReadUnitTypes(const std::string& path, sc2::UnitTypes& unit_types) {
+    std::ifstream file(path);
+
+    if (!file) {
+        return false;
+    }
+
+    unit_types.clear();
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream stream(line);
+
+        uint32_t id;
+        sc2::UnitTypeData unit_type {};
+
+        if (!(stream >> id >> unit_type.build_time >> unit_type.name)) {
+            return false;
+        }
+
+        unit_type.unit_type_id = id;
+        unit_type.available = true;
+
+        // Keep the table indexed by unit type id, like the data of the game
+        if (unit_types.size() <= id) {
+            unit_types.resize(id + 1);
+        }
+
+        unit_types[id] = unit_type;
+    }
+
+    return true;
+}
+
 bool scbot::Utilities::AnyWithinRange(const sc2::Units& units, const sc2::Point2D& point, float range) {
     range *= range;
 
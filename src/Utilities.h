@@ -1,6 +1,9 @@
 #pragma once
 
 #include <sc2api/sc2_unit.h>
+#include <sc2api/sc2_data.h>
+
+#include <string>
 
 namespace scbot::Utilities {
 
@@ -212,6 +215,26 @@ float ToSecondsFromGameTime(float time);
  */
 float ToGameTimeFromSeconds(float time);
 
+// Data utility functions
+
+/**
+ * @brief Write the unit type data used outside of a game to a text file, one unit type per line.
+ * 
+ * @param path The file to write.
+ * @param unit_types The unit type data of the game.
+ * @return true If the file was written, false otherwise.
+ */
+bool WriteUnitTypes(const std::string& path, const sc2::UnitTypes& unit_types);
+
+/**
+ * @brief Read unit type data written by WriteUnitTypes.
+ * 
+ * @param path The file to read.
+ * @param unit_types The unit type data, indexed by unit type id like the data of the game.
+ * @return true If the file was read, false otherwise.
+ */
+bool ReadUnitTypes(const std::string& path, sc2::UnitTypes& unit_types);
+
 /**
  * @brief Check if any unit is within a certain distance of a point.
  * 
@@ -0,0 +1,73 @@
+#include "Zobrist.h"
+
+#include <cmath>
+
+namespace {
+
+enum class KeyKind : uint64_t {
+    Unit = 1,
+    Minerals = 2,
+    Vespene = 3,
+    Time = 4,
+    Turn = 5,
+    Planned = 6
+};
+
+// The keys are derived from a fixed seed so that hashes are stable between runs.
+constexpr uint64_t Seed = 0x5C2B07A1E5D3C0DEull;
+
+// splitmix64 finalizer, gives well distributed keys without having to store a table.
+uint64_t Mix(uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+uint64_t Key(KeyKind kind, bool friendly, uint64_t id, uint64_t value)
+{
+    return Mix(Seed ^ (static_cast<uint64_t>(kind) << 60) ^ (static_cast<uint64_t>(friendly) << 59) ^ (id << 32) ^ (value & 0xFFFFFFFFull));
+}
+
+}
+
+uint64_t scbot::Zobrist::UnitKey(bool friendly, sc2::UNIT_TYPEID type, uint32_t count)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    return Key(KeyKind::Unit, friendly, static_cast<uint64_t>(type) & 0x7FFFFFF, count);
+}
+
+uint64_t scbot::Zobrist::PlannedKey(bool friendly, sc2::UNIT_TYPEID type, uint32_t count)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    return Key(KeyKind::Planned, friendly, static_cast<uint64_t>(type) & 0x7FFFFFF, count);
+}
+
+uint64_t scbot::Zobrist::ResourceKey(bool friendly, const scdata::ResourcePair& resources)
+{
+    const auto minerals = static_cast<uint32_t>(resources.minerals / ResourceBucket);
+    const auto vespene = static_cast<uint32_t>(resources.vespene / ResourceBucket);
+
+    return Key(KeyKind::Minerals, friendly, 0, minerals) ^ Key(KeyKind::Vespene, friendly, 0, vespene);
+}
+
+uint64_t scbot::Zobrist::TimeKey(bool friendly, float time)
+{
+    const auto bucket = static_cast<uint32_t>(static_cast<int32_t>(std::floor(time / TimeBucket)));
+
+    return Key(KeyKind::Time, friendly, 0, bucket);
+}
+
+uint64_t scbot::Zobrist::TurnKey()
+{
+    static const uint64_t key = Key(KeyKind::Turn, true, 0, 0);
+
+    return key;
+}
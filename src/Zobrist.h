@@ -0,0 +1,62 @@
+#pragma once
+
+#include <sc2api/sc2_typeenums.h>
+
+#include <cstdint>
+
+#include "Data.h"
+
+namespace scbot::Zobrist {
+
+// Resources are hashed in buckets so that positions which only differ by a few minerals share a key.
+constexpr int32_t ResourceBucket = 25;
+
+// Time is hashed in buckets of whole seconds.
+constexpr float TimeBucket = 1.0f;
+
+/**
+ * @brief Get the key for a player owning a number of units of a type.
+ *
+ * @param friendly Whether the units belong to the friendly player.
+ * @param type The unit type.
+ * @param count The number of units of the type.
+ * @return The key, 0 if the count is 0 so that absent and empty entries hash the same.
+ */
+uint64_t UnitKey(bool friendly, sc2::UNIT_TYPEID type, uint32_t count);
+
+/**
+ * @brief Get the key for a player having a number of units of a type in production.
+ *
+ * @param friendly Whether the units belong to the friendly player.
+ * @param type The unit type.
+ * @param count The number of units of the type in production.
+ * @return The key, 0 if the count is 0.
+ */
+uint64_t PlannedKey(bool friendly, sc2::UNIT_TYPEID type, uint32_t count);
+
+/**
+ * @brief Get the key for the bucketed resources of a player.
+ *
+ * @param friendly Whether the resources belong to the friendly player.
+ * @param resources The resources.
+ * @return The key.
+ */
+uint64_t ResourceKey(bool friendly, const scdata::ResourcePair& resources);
+
+/**
+ * @brief Get the key for the bucketed time of a player.
+ *
+ * @param friendly Whether the time belongs to the friendly player.
+ * @param time The time in seconds.
+ * @return The key.
+ */
+uint64_t TimeKey(bool friendly, float time);
+
+/**
+ * @brief Get the key that is toggled when the friendly player is to move.
+ *
+ * @return The key.
+ */
+uint64_t TurnKey();
+
+}